@@ -0,0 +1,292 @@
+#include <SLutils/centerline.hpp>
+#include <SLutils/fringe_analysis.hpp>
+#include <SLutils/graycoding.hpp>
+#include <SLutils/multifrequency.hpp>
+#include <SLutils/phase_graycoding.hpp>
+#include <SLutils/stats.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include "synthetic.hpp" // makeFringes, makeGraycode, makePhaseMap
+
+#include <atomic>
+#include <chrono>
+
+
+/* ---------------------------------------------------------------------------
+cv::Mat allocator that keeps track of the bytes allocated by all the arrays,
+to report the peak memory of each benchmark. Only the cv::Mat data is
+counted, which holds the input frames, the outputs and the intermediate maps.
+--------------------------------------------------------------------------- */
+class CountingAllocator : public cv::MatAllocator {
+public:
+    CountingAllocator() : std_allocator(cv::Mat::getStdAllocator()) {}
+    
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        cv::UMatData* u = std_allocator->allocate(dims, sizes, type, data, step, flags, usage);
+        if (u and !data) {
+            const size_t now = current += u->size;
+            size_t prev = peak;
+            while (now > prev and !peak.compare_exchange_weak(prev, now)) {}
+        }
+        if (u)
+            u->currAllocator = u->prevAllocator = this;
+        return u;
+    }
+    
+    bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        return std_allocator->allocate(u, flags, usage);
+    }
+    
+    void deallocate(cv::UMatData* u) const override {
+        if (u and !(u->flags & cv::UMatData::USER_ALLOCATED))
+            current -= u->size;
+        std_allocator->deallocate(u);
+    }
+    
+    // Start measuring the peak from the memory allocated now
+    void resetPeak() const { peak = current.load(); }
+    
+    // Peak memory in bytes since resetPeak, relative to the memory allocated at that time
+    size_t peakSince(size_t baseline) const { return peak - baseline; }
+    
+    size_t allocated() const { return current; }
+
+private:
+    cv::MatAllocator* std_allocator;
+    mutable std::atomic<size_t> current{0}, peak{0};
+};
+
+static CountingAllocator& countingAllocator() {
+    static CountingAllocator allocator;
+    return allocator;
+}
+
+// Report pixels per second and the peak memory of the timed loop, including the outputs
+static void reportPixelsAndMemory(benchmark::State& state, int h, int w, size_t baseline) {
+    state.SetItemsProcessed(state.iterations()*h*w);
+    state.counters["peak_MB"] = countingAllocator().peakSince(baseline)/1e6;
+}
+
+// Time of a stage in ms, averaged over the iterations
+static void addStageTime(benchmark::State& state, const char* name, std::chrono::steady_clock::duration t) {
+    state.counters[name] = benchmark::Counter(std::chrono::duration<double, std::milli>(t).count(),
+                                              benchmark::Counter::kAvgIterations);
+}
+
+// Time of a library stage in ms, averaged over the iterations, from the statistics recorded
+// between before and after (SLU_ENABLE_STATS builds only)
+static void addStageTime(benchmark::State& state, const char* name, const sl::Stats& before,
+                         const sl::Stats& after, sl::StatsStage stage) {
+    state.counters[name] = benchmark::Counter(after.stages[stage].time_ms - before.stages[stage].time_ms,
+                                              benchmark::Counter::kAvgIterations);
+}
+
+// Memory baseline after setting up the inputs: the peak is measured from here
+static size_t startMemory() {
+    countingAllocator().resetPeak();
+    return countingAllocator().allocated();
+}
+
+static void BM_NStepPhaseShifting(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1), N = 12;
+    std::vector<cv::Mat> images = makeFringes(h, w, 18, N);
+    cv::Mat phase;
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::NStepPhaseShifting(images, phase, N);
+        benchmark::DoNotOptimize(phase.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+static void BM_ThreeStepPhaseShifting(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    std::vector<cv::Mat> images = makeFringes(h, w, 18, 3);
+    cv::Mat phase;
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::ThreeStepPhaseShifting(images, phase);
+        benchmark::DoNotOptimize(phase.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+static void BM_decimalMap(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    std::vector<cv::Mat> images = makeGraycode(h, w, 18);
+    cv::Mat dec;
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::decimalMap(images, dec);
+        benchmark::DoNotOptimize(dec.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+static void BM_gray2dec(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    cv::Mat code_word, dec;
+    sl::graycodeword(makeGraycode(h, w, 18), code_word);
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::gray2dec(code_word, dec);
+        benchmark::DoNotOptimize(dec.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+static void BM_spatialUnwrap(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    cv::Mat phased, mask, Phi;
+    makePhaseMap(h, w, phased, mask);
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::spatialUnwrap(phased, {w/2, h/2}, mask, Phi);
+        benchmark::DoNotOptimize(Phi.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+/* ---------------------------------------------------------------------------
+Stage times of the multi-stage functions. With SLU_ENABLE_STATS they are the
+per-stage times recorded by the library during the timed calls (wrap_ms,
+order_ms, median_ms and unwrap_ms). Otherwise the first stages are rerun
+alone outside of the timed loop (wrap_rerun_ms and order_rerun_ms), and the
+unwrapping stage is not reported since it cannot be isolated.
+--------------------------------------------------------------------------- */
+
+static void BM_threeFreqPhaseUnwrap(benchmark::State& state) {
+    using clock = std::chrono::steady_clock;
+    const int h = state.range(0), w = state.range(1), N = 4;
+    const cv::Vec3i p(36, 42, 48), Ns(N, N, N);
+    std::vector<cv::Mat> images = makeFringes(h, w, {p[0], p[1], p[2]}, N);
+    std::vector<cv::Mat> frames[3] = {{images.begin(), images.begin() + N},
+                                      {images.begin() + N, images.begin() + 2*N},
+                                      {images.begin() + 2*N, images.end()}};
+    cv::Mat phi, Phi;
+    clock::duration wrap{};
+    
+    const size_t baseline = startMemory();
+    const sl::Stats before = sl::getStats();
+    for (auto _ : state) {
+        sl::threeFreqPhaseUnwrap(images, Phi, p, Ns);
+        benchmark::DoNotOptimize(Phi.data);
+        if (sl::statsEnabled())
+            continue;
+        
+        // Wrapped phase stage alone, outside of the timed loop. phi is released so that the stage
+        // does not add to the peak memory of threeFreqPhaseUnwrap
+        state.PauseTiming();
+        const clock::time_point t0 = clock::now();
+        for (int k = 0; k < 3; k++)
+            sl::NStepPhaseShifting(frames[k], phi, N);
+        wrap += clock::now() - t0;
+        phi.release();
+        state.ResumeTiming();
+    }
+    
+    if (sl::statsEnabled()) {
+        const sl::Stats after = sl::getStats();
+        addStageTime(state, "wrap_ms", before, after, sl::STATS_PHASE);
+        addStageTime(state, "unwrap_ms", before, after, sl::STATS_UNWRAP);
+    }
+    else
+        addStageTime(state, "wrap_rerun_ms", wrap);
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+static void BM_phaseGraycodingUnwrap(benchmark::State& state) {
+    using clock = std::chrono::steady_clock;
+    const int h = state.range(0), w = state.range(1), p = 18, N = 18;
+    std::vector<cv::Mat> images_ps = makeFringes(h, w, p, N), images_gc = makeGraycode(h, w, p);
+    cv::Mat phi, k, Phi;
+    clock::duration wrap{}, order{};
+    
+    const size_t baseline = startMemory();
+    const sl::Stats before = sl::getStats();
+    for (auto _ : state) {
+        sl::phaseGraycodingUnwrap(images_ps, images_gc, Phi, p, N);
+        benchmark::DoNotOptimize(Phi.data);
+        if (sl::statsEnabled())
+            continue;
+        
+        // Wrapped phase and graycode stages alone, outside of the timed loop. Their outputs are
+        // released so that they do not add to the peak memory of phaseGraycodingUnwrap
+        state.PauseTiming();
+        const clock::time_point t0 = clock::now();
+        sl::NStepPhaseShifting(images_ps, phi, N);
+        const clock::time_point t1 = clock::now();
+        sl::decimalMap(images_gc, k);
+        order += clock::now() - t1;
+        wrap += t1 - t0;
+        phi.release();
+        k.release();
+        state.ResumeTiming();
+    }
+    
+    if (sl::statsEnabled()) {
+        const sl::Stats after = sl::getStats();
+        addStageTime(state, "wrap_ms", before, after, sl::STATS_PHASE);
+        addStageTime(state, "order_ms", before, after, sl::STATS_GRAYCODE);
+        addStageTime(state, "median_ms", before, after, sl::STATS_MEDIAN);
+        addStageTime(state, "unwrap_ms", before, after, sl::STATS_UNWRAP);
+    }
+    else {
+        addStageTime(state, "wrap_rerun_ms", wrap);
+        addStageTime(state, "order_rerun_ms", order);
+    }
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+// Complementary graycode of stripes of half the period, i.e. one more bit than makeGraycode(h, w, p)
+static void BM_complementaryGraycodingUnwrap(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1), p = 18, N = 18;
+    std::vector<cv::Mat> images_ps = makeFringes(h, w, p, N), images_gc = makeGraycode(h, w, p/2);
+    cv::Mat Phi;
+    
+    const size_t baseline = startMemory();
+    for (auto _ : state) {
+        sl::complementaryGraycodingUnwrap(images_ps, images_gc, Phi, N);
+        benchmark::DoNotOptimize(Phi.data);
+    }
+    
+    reportPixelsAndMemory(state, h, w, baseline);
+}
+
+// VGA, 5 MP and 12 MP
+#define SLU_RESOLUTIONS ->ArgNames({"h", "w"})->Args({480, 640})->Args({1944, 2592})->Args({3000, 4000}) \
+                        ->Unit(benchmark::kMillisecond)->UseRealTime()
+
+BENCHMARK(BM_NStepPhaseShifting)->Name("NStepPhaseShifting/N:12") SLU_RESOLUTIONS;
+BENCHMARK(BM_ThreeStepPhaseShifting)->Name("ThreeStepPhaseShifting") SLU_RESOLUTIONS;
+BENCHMARK(BM_decimalMap)->Name("decimalMap") SLU_RESOLUTIONS;
+BENCHMARK(BM_gray2dec)->Name("gray2dec") SLU_RESOLUTIONS;
+BENCHMARK(BM_spatialUnwrap)->Name("spatialUnwrap") SLU_RESOLUTIONS;
+BENCHMARK(BM_threeFreqPhaseUnwrap)->Name("threeFreqPhaseUnwrap/N:4") SLU_RESOLUTIONS;
+BENCHMARK(BM_phaseGraycodingUnwrap)->Name("phaseGraycodingUnwrap/N:18") SLU_RESOLUTIONS;
+BENCHMARK(BM_complementaryGraycodingUnwrap)->Name("complementaryGraycodingUnwrap/N:18") SLU_RESOLUTIONS;
+
+int main(int argc, char** argv) {
+    // Count the memory of all the arrays allocated by the benchmarks
+    cv::Mat::setDefaultAllocator(&countingAllocator());
+    
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    
+    return 0;
+}
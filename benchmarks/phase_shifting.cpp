@@ -0,0 +1,72 @@
+#include <SLutils/config.hpp>
+#include <SLutils/fringe_analysis.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include "synthetic.hpp" // makeFringes
+
+
+enum Mode {EXACT, FAST, LUT};
+
+static void setMode(Mode mode) {
+    sl::setPhaseAccuracy(mode == FAST ? sl::PHASE_ACCURACY_FAST : sl::PHASE_ACCURACY_EXACT);
+    sl::setPhaseLUT(mode == LUT);
+}
+
+// Args: image height, image width and mode
+static void BM_ThreeStep(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    std::vector<cv::Mat> images = makeFringes(h, w, w/16.0, 3);
+    cv::Mat phase, modulation;
+    setMode(static_cast<Mode>(state.range(2)));
+    
+    for (auto _ : state) {
+        sl::ThreeStepPhaseShifting_modulation(images, phase, modulation, CV_32F);
+        benchmark::DoNotOptimize(phase.data);
+    }
+    
+    setMode(EXACT);
+    state.SetItemsProcessed(state.iterations()*h*w);
+}
+
+static void BM_FourStep(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    std::vector<cv::Mat> images = makeFringes(h, w, w/16.0, 4);
+    cv::Mat phase, modulation;
+    setMode(static_cast<Mode>(state.range(2)));
+    
+    for (auto _ : state) {
+        sl::NStepPhaseShifting_modulation(images, phase, modulation, 4, CV_32F);
+        benchmark::DoNotOptimize(phase.data);
+    }
+    
+    setMode(EXACT);
+    state.SetItemsProcessed(state.iterations()*h*w);
+}
+
+// Args: image height, image width and number of steps. N = 3, 4, 6 and 8 use the integer kernels,
+// N = 5 and 7 the generic one
+static void BM_NStep(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1), N = state.range(2);
+    std::vector<cv::Mat> images = makeFringes(h, w, w/16.0, N);
+    cv::Mat phase;
+    
+    for (auto _ : state) {
+        sl::NStepPhaseShifting(images, phase, N, CV_32F);
+        benchmark::DoNotOptimize(phase.data);
+    }
+    
+    state.SetItemsProcessed(state.iterations()*h*w);
+    state.SetBytesProcessed(state.iterations()*h*w*(N + 4));
+}
+
+BENCHMARK(BM_ThreeStep)->Name("ThreeStepPhaseShifting")->ArgNames({"h", "w", "mode"})
+    ->ArgsProduct({{480}, {640}, {EXACT, FAST, LUT}})->ArgsProduct({{3000}, {4000}, {EXACT, FAST, LUT}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_FourStep)->Name("FourStepPhaseShifting")->ArgNames({"h", "w", "mode"})
+    ->ArgsProduct({{480}, {640}, {EXACT, FAST, LUT}})->ArgsProduct({{3000}, {4000}, {EXACT, FAST, LUT}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_NStep)->Name("NStepPhaseShifting")->ArgNames({"h", "w", "N"})
+    ->ArgsProduct({{3000}, {4000}, {3, 4, 5, 6, 7, 8}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
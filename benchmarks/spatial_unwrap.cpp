@@ -0,0 +1,45 @@
+#include <SLutils/centerline.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include "synthetic.hpp" // makePhaseMap
+
+
+template <void (*Unwrap)(cv::InputArray, const cv::Point, cv::InputArray, cv::OutputArray)>
+static void BM_spatialUnwrap(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    cv::Mat phased, mask, Phi;
+    makePhaseMap(h, w, phased, mask);
+    
+    for (auto _ : state) {
+        Unwrap(phased, {w/2, h/2}, mask, Phi);
+        benchmark::DoNotOptimize(Phi.data);
+    }
+    
+    state.SetItemsProcessed(state.iterations()*h*w);
+}
+
+BENCHMARK(BM_spatialUnwrap<sl::spatialUnwrap>)->Name("spatialUnwrap")
+    ->Args({480, 640})->Args({3000, 4000})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_spatialUnwrap<sl::spatialUnwrapScanline>)->Name("spatialUnwrapScanline")
+    ->Args({480, 640})->Args({3000, 4000})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_qualityGuidedUnwrap(benchmark::State& state) {
+    const int h = state.range(0), w = state.range(1);
+    cv::Mat phased, mask, pdv, Phi;
+    makePhaseMap(h, w, phased, mask);
+    sl::phaseDerivativeVariance(phased, pdv);
+    cv::Mat quality = -pdv;
+    
+    for (auto _ : state) {
+        sl::qualityGuidedUnwrap(phased, quality, {w/2, h/2}, mask, Phi);
+        benchmark::DoNotOptimize(Phi.data);
+    }
+    
+    state.SetItemsProcessed(state.iterations()*h*w);
+}
+
+BENCHMARK(BM_qualityGuidedUnwrap)->Name("qualityGuidedUnwrap")
+    ->Args({480, 640})->Args({3000, 4000})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <SLutils/patterns.hpp>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp> // cv::circle
+
+#include <algorithm> // std::min
+#include <cmath>
+#include <vector>
+
+
+/* ---------------------------------------------------------------------------
+Synthetic inputs of the benchmarks, so that no image assets are needed. The
+fringe and graycode images are rendered with the pattern generators, with a
+reduced contrast and a slight defocus as in a capture.
+--------------------------------------------------------------------------- */
+inline sl::PatternModel captureModel() {
+    sl::PatternModel model;
+    model.offset = 128;
+    model.amplitude = 100;
+    model.defocus = 1;
+    return model;
+}
+
+// 2D headers to the frames of a (n,h,w) pattern stack
+inline std::vector<cv::Mat> splitFrames(const cv::Mat& stack) {
+    std::vector<cv::Mat> frames;
+    cv::_InputArray(stack).getMatVector(frames);
+    return frames;
+}
+
+// N 8-bit fringe images of period p
+inline std::vector<cv::Mat> makeFringes(int h, int w, double p, int N) {
+    cv::Mat stack;
+    sl::generateFringes(p, N, {w, h}, stack, captureModel());
+    return splitFrames(stack);
+}
+
+// N fringe images of each period of p, in the order of the periods
+inline std::vector<cv::Mat> makeFringes(int h, int w, const std::vector<int>& p, int N) {
+    std::vector<cv::Vec2i> freqs;
+    for (int period : p)
+        freqs.push_back({period, N});
+    
+    cv::Mat stack;
+    sl::generateMultiFreqFringes(freqs, {w, h}, stack, captureModel());
+    return splitFrames(stack);
+}
+
+// Graycode patterns and inverted patterns of the fringe order x/p, with as many bits as needed
+// to cover the width
+inline std::vector<cv::Mat> makeGraycode(int h, int w, int p) {
+    int n = 0;
+    while ((1 << n) < (w + p - 1)/p)
+        n++;
+    
+    cv::Mat stack;
+    sl::generateGrayCode(n, {w, h}, true, stack, p, captureModel());
+    return splitFrames(stack);
+}
+
+// Wrapped phase map of a tilted plane with a Gaussian bump, with a circular mask covering most
+// of the image
+inline void makePhaseMap(int h, int w, cv::Mat& phased, cv::Mat& mask) {
+    phased.create(h, w, CV_64F);
+    for (int y = 0; y < h; y++) {
+        double* pphased = phased.ptr<double>(y);
+        for (int x = 0; x < w; x++) {
+            const double dx = x - 0.5*w, dy = y - 0.5*h;
+            const double Phi = 0.05*x + 0.03*y + 20*std::exp(-(dx*dx + dy*dy)/(0.05*w*w));
+            pphased[x] = std::atan2(std::sin(Phi), std::cos(Phi));
+        }
+    }
+    
+    mask = cv::Mat::zeros(h, w, CV_8U);
+    cv::circle(mask, {w/2, h/2}, cvRound(0.48*std::min(h, w)), 255, cv::FILLED);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace sl {
+
+// Input of one phase-shifting + graycoding scan, with the arguments of phaseGraycodingUnwrap. An
+// empty mask unwraps all the pixels
+struct PhaseGraycodingScan {
+    std::vector<std::string> impaths_ps, impaths_gc;
+    int p, N;
+    cv::Mat mask;
+};
+
+/* ---------------------------------------------------------------------------
+Unwrap many scans with phaseGraycodingUnwrap sharing the OpenCV thread pool,
+with at most sl::getNumThreads() threads. The schedule of each scan depends
+on its number of pixels (of its mask, or else of its first image). Scans of
+at least 1 MP are processed one after the other, each split in row bands as
+in the single-scan functions. Smaller scans are processed concurrently, one
+whole scan per thread, and each thread pulls the next pending scan as soon as
+it is done. on_result(i, Phi) is called as soon as the scan i is unwrapped,
+in completion order and never concurrently, so it can store or write the
+result without locking. If some scans fail, the other scans are still
+processed and the first error is thrown at the end.
+--------------------------------------------------------------------------- */
+void phaseGraycodingUnwrapBatch(const std::vector<PhaseGraycodingScan>& scans,
+                                const std::function<void(int, const cv::Mat&)>& on_result, int dtype = CV_64F);
+
+// Unwrapped phase maps of all the scans, in the order of scans
+std::vector<cv::Mat> phaseGraycodingUnwrapBatch(const std::vector<PhaseGraycodingScan>& scans, int dtype = CV_64F);
+
+} // namespace sl
@@ -8,6 +8,22 @@ namespace sl {
 
 cv::Point seedPoint(const std::string& fn_clx, const std::string& fn_cly, cv::InputArray mask);
 
+cv::Point seedPoint(cv::InputArray clx, cv::InputArray cly, cv::InputArray mask);
+
 void spatialUnwrap(cv::InputArray phased, const cv::Point p0, cv::InputArray mask, cv::OutputArray Phi);
 
+// Scanline version of spatialUnwrap that unwraps row runs in parallel bands and stitches them.
+// On clean phase maps the result is the same as spatialUnwrap up to floating-point rounding
+void spatialUnwrapScanline(cv::InputArray phased, const cv::Point p0, cv::InputArray mask, cv::OutputArray Phi);
+
+// Quality-guided version of spatialUnwrap: pixels with higher quality values are unwrapped first.
+// The quality map can be the data modulation of the fringe images or the negative of the phase
+// derivative variance. It is quantized in 1024 levels with a bucketed queue
+void qualityGuidedUnwrap(cv::InputArray phased, cv::InputArray quality, const cv::Point p0, cv::InputArray mask,
+                         cv::OutputArray Phi);
+
+// Phase derivative variance of a wrapped phase map (CV_32F or CV_64F) in ksize x ksize windows.
+// Low values mean reliable phase
+void phaseDerivativeVariance(cv::InputArray phased, cv::OutputArray pdv, int ksize = 3);
+
 } // namespace sl
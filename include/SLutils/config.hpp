@@ -0,0 +1,35 @@
+#pragma once
+
+
+namespace sl {
+
+// Set the maximum number of threads used by the CPU kernels. A value <= 0 restores the
+// default, which is the number of threads of the OpenCV thread pool (cv::getNumThreads).
+// With 1 thread all kernels run serially on the calling thread.
+void setNumThreads(int nthreads);
+
+int getNumThreads();
+
+
+enum PhaseAccuracy {
+    // Use the C math library (std::atan2, std::sin, std::cos). This is the default
+    PHASE_ACCURACY_EXACT,
+    // Use vectorized branch-free approximations. The absolute error with respect to
+    // PHASE_ACCURACY_EXACT is below 1e-15 rad for CV_64F and 1e-6 rad for CV_32F outputs
+    PHASE_ACCURACY_FAST
+};
+
+// Set how the CPU kernels evaluate atan2 and rewrap phase values
+void setPhaseAccuracy(PhaseAccuracy accuracy);
+
+PhaseAccuracy getPhaseAccuracy();
+
+// Use precomputed lookup tables in the three-step algorithm and in the N-step algorithm with
+// N = 3 or 4 (and all the images in one period). The tables (about 4 MB for CV_32F and 8 MB for
+// CV_64F outputs) are built on first use and give the same results as PHASE_ACCURACY_EXACT,
+// which they take precedence over. CPU version only. Disabled by default
+void setPhaseLUT(bool enable);
+
+bool getPhaseLUT();
+
+} // namespace sl
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <cstddef>
+#include <string>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+Raw frame-stack container: a fixed header followed by a metadata string and
+by n contiguous single-channel (h,w) frames of depth CV_8U to CV_64F, so that a whole scan is loaded
+without decoding any image. Layout (native byte order):
+
+    char     magic[4]      "SLFS"
+    uint32   version       1
+    int32    width, height
+    int32    type          OpenCV type of the frames, e.g. CV_8UC1
+    int32    count         number of frames
+    uint64   meta_size     bytes of the metadata string (without terminator)
+    uint64   data_offset   offset of the first frame, a multiple of 64
+    char     meta[meta_size]
+    ...      frames, from data_offset, count*height*width*elemSize bytes
+
+The metadata is a free-form string, e.g. the pattern layout of the scan.
+--------------------------------------------------------------------------- */
+void writeFrameStack(const std::string& path, cv::InputArrayOfArrays images, const std::string& metadata = "");
+
+/* ---------------------------------------------------------------------------
+Read-only memory-mapped view of a frame-stack file. frames() returns a
+(count,h,w) array header into the mapping that the InputArrayOfArrays
+overloads of the library functions consume without copying, e.g.
+NStepPhaseShifting(stack.frames(0, N), phase, N). The arrays returned by
+frames and frame are only valid while the FrameStack is open.
+--------------------------------------------------------------------------- */
+class FrameStack {
+public:
+    FrameStack() = default;
+    explicit FrameStack(const std::string& path) { open(path); }
+    ~FrameStack() { close(); }
+    
+    FrameStack(FrameStack&& other) noexcept;
+    FrameStack& operator=(FrameStack&& other) noexcept;
+    FrameStack(const FrameStack&) = delete;
+    FrameStack& operator=(const FrameStack&) = delete;
+    
+    void open(const std::string& path);
+    
+    void close();
+    
+    bool isOpened() const { return base != nullptr; }
+    
+    int count() const { return n_frames; }
+    cv::Size size() const { return frame_size; }
+    int type() const { return frame_type; }
+    const std::string& metadata() const { return meta; }
+    
+    // (count,h,w) array with frames first, first+1, ..., first+count-1
+    cv::Mat frames(int first, int count) const;
+    cv::Mat frames() const { return frames(0, n_frames); }
+    
+    // (h,w) array of the frame i
+    cv::Mat frame(int i) const;
+
+private:
+    void* base = nullptr;
+    std::size_t map_size = 0;
+    const unsigned char* data = nullptr;
+    std::size_t frame_bytes = 0;
+    
+    int n_frames = 0, frame_type = 0;
+    cv::Size frame_size;
+    std::string meta;
+};
+
+} // namespace sl
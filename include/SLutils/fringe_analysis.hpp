@@ -1,5 +1,7 @@
 #pragma once
 
+#include <SLutils/workspace.hpp>
+
 #include <opencv2/imgcodecs.hpp>
 #include <vector>
 #include <string>
@@ -7,14 +9,56 @@
 
 namespace sl {
 
-void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray phase, int N);
+// All the functions estimate the output maps in double (dtype = CV_64F) or single (dtype = CV_32F)
+// precision. For 8-bit fringe images both give the same phase up to ~3e-7 rad. With an optional CV_8U
+// mask only its non-zero pixels are computed, and the outputs are 0 elsewhere. For a ROI, use a
+// rectangular mask or pass sub-array views of the images. When the N images of one period are given by
+// path, they are accumulated with PhaseShiftAccumulator as they are decoded (see SLutils/streaming.hpp)
+
+void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray phase, int N, int dtype = CV_64F,
+                        cv::InputArray mask = cv::noArray());
+
+void NStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray phase, int N, int dtype = CV_64F,
+                        Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
 
 void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray phase,
-                                   cv::OutputArray data_modulation, int N);
+                                   cv::OutputArray data_modulation, int N, int dtype = CV_64F,
+                                   cv::InputArray mask = cv::noArray());
+
+void NStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray phase,
+                                   cv::OutputArray data_modulation, int N, int dtype = CV_64F,
+                                   Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
+
+// Criteria of the validity mask of the decoders: a pixel is valid if its data modulation is at least
+// min_modulation and all its intensities are below saturation (256 disables the saturation test)
+struct ValidityCriteria {
+    double min_modulation = 0.1;
+    int saturation = 255;
+};
 
-void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray phase);
+// Wrapped phase and CV_8U validity mask (255 at the valid pixels, 0 elsewhere and outside the optional
+// mask), computed in the same pass over the fringe images. The validity mask can be given directly as
+// the mask of spatialUnwrap, or of any other decoder
+void NStepPhaseShifting_valid(const std::vector<std::string>& impaths, cv::OutputArray phase, cv::OutputArray valid,
+                              int N, const ValidityCriteria& criteria = ValidityCriteria(), int dtype = CV_64F,
+                              cv::InputArray mask = cv::noArray());
+
+void NStepPhaseShifting_valid(cv::InputArrayOfArrays images, cv::OutputArray phase, cv::OutputArray valid, int N,
+                              const ValidityCriteria& criteria = ValidityCriteria(), int dtype = CV_64F,
+                              Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
+
+void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray phase, int dtype = CV_64F,
+                            cv::InputArray mask = cv::noArray());
+
+void ThreeStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray phase, int dtype = CV_64F,
+                            Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
 
 void ThreeStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray phase,
-                                       cv::OutputArray data_modulation);
+                                       cv::OutputArray data_modulation, int dtype = CV_64F,
+                                       cv::InputArray mask = cv::noArray());
+
+void ThreeStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray phase,
+                                       cv::OutputArray data_modulation, int dtype = CV_64F,
+                                       Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
 
 } // namespace sl
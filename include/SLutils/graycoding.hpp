@@ -1,5 +1,7 @@
 #pragma once
 
+#include <SLutils/workspace.hpp>
+
 #include <opencv2/imgcodecs.hpp>
 #include <vector>
 #include <string>
@@ -7,10 +9,29 @@
 
 namespace sl {
 
-void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray dec);
+// With an optional CV_8U mask the decoders only read and decode its non-zero pixels, and the outputs
+// are 0 elsewhere
+
+void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray dec, cv::InputArray mask = cv::noArray());
+
+void decimalMap(cv::InputArrayOfArrays images, cv::OutputArray dec, Workspace* ws = nullptr,
+                cv::InputArray mask = cv::noArray());
+
+void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray code_word,
+                  cv::InputArray mask = cv::noArray());
+
+void graycodeword(cv::InputArrayOfArrays images, cv::OutputArray code_word, Workspace* ws = nullptr,
+                  cv::InputArray mask = cv::noArray());
+
+// Bit-packed version of graycodeword: a (h,w) CV_16U array where the bit n-k-1 of each word is
+// the k-th gray bit, i.e. the first pair of images gives the MSB. Supports up to 16 bits
+void graycodewordPacked(const std::vector<std::string>& impaths, cv::OutputArray code_word,
+                        cv::InputArray mask = cv::noArray());
 
-void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray code_word);
+void graycodewordPacked(cv::InputArrayOfArrays images, cv::OutputArray code_word, Workspace* ws = nullptr,
+                        cv::InputArray mask = cv::noArray());
 
+// code_word can be the (n,h,w) output of graycodeword or the packed output of graycodewordPacked
 void gray2dec(cv::InputArray code_word, cv::OutputArray dec);
 
 } // namespace sl
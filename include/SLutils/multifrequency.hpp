@@ -1,16 +1,58 @@
 #pragma once
 
+#include <SLutils/workspace.hpp>
+
 #include <opencv2/imgproc.hpp>
 #include <vector>
 #include <string>
 
 namespace sl {
 
+// With an optional CV_8U mask only its non-zero pixels (and the tiles around them) are computed, and
+// Phi is 0 elsewhere. The valid pixels get the same phase as without a mask
+
 void threeFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray Phi,
-                          const cv::Vec3i& p, const cv::Vec3i& N);
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype = CV_64F,
+                          cv::InputArray mask = cv::noArray());
+
+void threeFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray Phi,
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype = CV_64F, Workspace* ws = nullptr,
+                          cv::InputArray mask = cv::noArray());
 
 
 void twoFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray Phi,
-                        const cv::Vec3i& p, const cv::Vec3i& N);
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype = CV_64F,
+                        cv::InputArray mask = cv::noArray());
+
+void twoFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray Phi,
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype = CV_64F, Workspace* ws = nullptr,
+                        cv::InputArray mask = cv::noArray());
+
+
+enum MultiFreqMethod {
+    // Heterodyne (multi-wavelength) unwrapping with the equivalent phases of the frequencies, as
+    // in threeFreqPhaseUnwrap and twoFreqPhaseUnwrap
+    MULTIFREQ_HETERODYNE,
+    // Hierarchical unwrapping from the widest to the narrowest period. The widest period must
+    // cover the whole field with a single fringe
+    MULTIFREQ_HIERARCHICAL,
+    // Number-theoretic unwrapping (Chinese remainder theorem) for integer periods. The fringe
+    // orders are unambiguous up to the least common multiple of the periods. Pixels with
+    // inconsistent phases, or whose phases match several fringe orders (which can happen when the
+    // periods share a common factor), are set to NaN. Not available in the CUDA version
+    MULTIFREQ_NUMBER_THEORETIC
+};
+
+// Temporal phase unwrapping with 2 to 8 frequencies. freqs has the (period in pixels, number of
+// phase shifts) pair of each frequency, in the order of the images, and Phi is the unwrapped phase
+// of the first frequency
+void multiFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method = MULTIFREQ_HETERODYNE,
+                          int dtype = CV_64F, cv::InputArray mask = cv::noArray());
+
+void multiFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method = MULTIFREQ_HETERODYNE,
+                          int dtype = CV_64F, Workspace* ws = nullptr,
+                          cv::InputArray mask = cv::noArray());
 
 } // namespace sl
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <cstdint>
+#include <vector>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+Intensity model of the generated patterns. The ideal pattern, with values
+offset + amplitude*cos(...) for fringes and offset +/- amplitude for graycode,
+goes through the gamma curve 255*(I/255)^gamma, a Gaussian defocus blur of
+sigma `defocus` pixels and additive Gaussian noise of sigma `noise` gray
+levels, and is finally rounded to 8 bits. The noise only depends on seed, so
+the patterns are reproducible. The defaults give ideal projector patterns.
+--------------------------------------------------------------------------- */
+struct PatternModel {
+    double offset = 127.5, amplitude = 127.5;
+    double gamma = 1;
+    double defocus = 0;
+    double noise = 0;
+    std::uint64_t seed = 0;
+};
+
+// N fringe patterns of period `period` pixels along x, as a (N,h,w) CV_8U array. The pattern i
+// has the phase 2*pi*x/period + 2*pi*(i + 1)/N, so NStepPhaseShifting recovers 2*pi*x/period
+// (wrapped) and phaseGraycodingUnwrap, with generateGrayCode of the same period, gives
+// Phi = 2*pi*x/period
+void generateFringes(double period, int N, cv::Size size, cv::OutputArray patterns,
+                     const PatternModel& model = PatternModel());
+
+// Fringe patterns of several frequencies, with the (period, number of phase shifts) pairs of
+// multiFreqPhaseUnwrap, stacked in the order of freqs as a (sum of N, h, w) CV_8U array
+void generateMultiFreqFringes(const std::vector<cv::Vec2i>& freqs, cv::Size size, cv::OutputArray patterns,
+                              const PatternModel& model = PatternModel());
+
+// Graycode patterns of nbits bits of the stripe index x/period, MSB first, as a (n,h,w) CV_8U
+// array. With inverted, each pattern is followed by its inverted version (n = 2*nbits), the order
+// expected by decimalMap. period = 0 uses the narrowest stripes that cover the width
+void generateGrayCode(int nbits, cv::Size size, bool inverted, cv::OutputArray patterns, int period = 0,
+                      const PatternModel& model = PatternModel());
+
+} // namespace sl
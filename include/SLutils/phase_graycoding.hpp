@@ -1,5 +1,8 @@
 #pragma once
 
+#include <SLutils/fringe_analysis.hpp> // ValidityCriteria
+#include <SLutils/workspace.hpp>
+
 #include <opencv2/imgproc.hpp>
 #include <vector>
 #include <string>
@@ -7,8 +10,49 @@
 
 namespace sl {
 
+// With an optional CV_8U mask only its non-zero pixels (and the tiles around them) are computed, and
+// Phi is 0 elsewhere. The valid pixels get the same phase as without a mask
+
 void phaseGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
                            const std::vector<std::string>& impaths_gc,
-                           cv::OutputArray Phi, int p, int N);
+                           cv::OutputArray Phi, int p, int N, int dtype = CV_64F,
+                           cv::InputArray mask = cv::noArray());
+
+void phaseGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                           cv::OutputArray Phi, int p, int N, int dtype = CV_64F, Workspace* ws = nullptr,
+                           cv::InputArray mask = cv::noArray());
+
+/* ---------------------------------------------------------------------------
+Complementary graycode unwrapping. images_gc are the n + 1 graycode patterns
+(with their inverted versions) of stripes of half the fringe period, e.g.
+generateGrayCode(n + 1, size, true, patterns, period/2), so the fringe period
+must be even: with an odd period the stripes drift away from the fringes.
+Their decimal map V gives two fringe orders with boundaries half a stripe
+apart: k1 = V >> 1 and k2 = (V + 1) >> 1. With the wrapped phase phi in
+[0, 2*pi), the order is k2 if phi < pi/2, k2 - 1 if phi > 3*pi/2 and k1
+otherwise, so the code transitions never fall near the phase jumps. Each pixel is unwrapped on its own, without
+the median filter of phaseGraycodingUnwrap. Phi = 2*pi*x/period
+--------------------------------------------------------------------------- */
+void complementaryGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
+                                   const std::vector<std::string>& impaths_gc,
+                                   cv::OutputArray Phi, int N, int dtype = CV_64F,
+                                   cv::InputArray mask = cv::noArray());
+
+void complementaryGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                   cv::OutputArray Phi, int N, int dtype = CV_64F, Workspace* ws = nullptr,
+                                   cv::InputArray mask = cv::noArray());
+
+// Same as phaseGraycodingUnwrap, also computing the validity mask in the phase pass. The gray codes are
+// only decoded and unwrapped in the tiles of the valid pixels, and Phi is 0 at the invalid pixels
+void phaseGraycodingUnwrap_valid(const std::vector<std::string>& impaths_ps,
+                                 const std::vector<std::string>& impaths_gc,
+                                 cv::OutputArray Phi, cv::OutputArray valid, int p, int N,
+                                 const ValidityCriteria& criteria = ValidityCriteria(), int dtype = CV_64F,
+                                 cv::InputArray mask = cv::noArray());
+
+void phaseGraycodingUnwrap_valid(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                 cv::OutputArray Phi, cv::OutputArray valid, int p, int N,
+                                 const ValidityCriteria& criteria = ValidityCriteria(), int dtype = CV_64F,
+                                 Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
 
 } // namespace sl
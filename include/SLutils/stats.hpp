@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace sl {
+
+// Stages of the decoding pipelines
+enum StatsStage {
+    STATS_IMREAD, // image decoding of the path-based functions
+    STATS_PHASE, // phase-shifting accumulation and atan2 (fused in one sweep)
+    STATS_GRAYCODE, // graycode decoding
+    STATS_MEDIAN, // spike detection, median and spike removal of phaseGraycodingUnwrap
+    STATS_UNWRAP, // phase unwrapping. Includes the median filter of the fused multi-frequency unwrapping
+    STATS_NUM_STAGES
+};
+
+struct StageStats {
+    double time_ms = 0; // wall time, measured on the calling thread
+    std::uint64_t calls = 0;
+    std::uint64_t bytes = 0; // bytes read and written by the stage
+};
+
+struct Stats {
+    StageStats stages[STATS_NUM_STAGES];
+    std::uint64_t allocations = 0, allocated_bytes = 0; // allocations of intermediate arrays
+    std::uint64_t spike_corrections = 0; // pixels corrected by the median-based spike removal
+    std::uint64_t spike_candidates = 0; // pixels whose median was computed by the spike removal
+};
+
+// Statistics are only recorded when the library is built with the SLU_ENABLE_STATS option.
+// Otherwise the instrumentation is compiled out and getStats always returns zeros
+bool statsEnabled();
+
+// Statistics accumulated by all the threads since the start or the last resetStats
+Stats getStats();
+
+void resetStats();
+
+const char* statsStageName(StatsStage stage);
+
+} // namespace sl
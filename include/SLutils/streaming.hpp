@@ -0,0 +1,88 @@
+#pragma once
+
+#include <SLutils/workspace.hpp>
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+Incremental N-step phase-shifting. Each fringe image updates the sin/cos sums
+as soon as it is pushed, so that finalize only estimates the atan2 (and the
+data modulation). The index of a fringe image gives its phase shift
+2*pi*(index + 1)/N, as in NStepPhaseShifting. Pushing the N images gives the
+result of NStepPhaseShifting up to rounding: the sums are accumulated in
+floating point, while NStepPhaseShifting uses integer kernels for N = 3, 4, 6
+and 8 and, with setPhaseLUT, table lookups.
+--------------------------------------------------------------------------- */
+class PhaseShiftAccumulator {
+public:
+    explicit PhaseShiftAccumulator(int N, int dtype = CV_64F);
+    
+    void push(cv::InputArray frame, int index);
+    
+    void finalize(cv::OutputArray phase, cv::OutputArray data_modulation = cv::noArray()) const;
+    
+    // Number of fringe images pushed since the construction or the last reset
+    int count() const { return n_frames; }
+    
+    void reset();
+
+private:
+    int N, dtype;
+    int n_frames = 0;
+    std::vector<bool> pushed;
+    cv::Mat sumIsin, sumIcos, sumI;
+};
+
+/* ---------------------------------------------------------------------------
+Incremental graycode decoding of n bits. Image 2k is the k-th graycode pattern
+and 2k+1 its inverted counterpart (the same order as in decimalMap). When both
+images of a pair have been pushed, their gray bit is packed in a per-pixel
+word, so that finalize only converts the gray words to decimal.
+--------------------------------------------------------------------------- */
+class GrayCodeAccumulator {
+public:
+    explicit GrayCodeAccumulator(int n);
+    
+    void push(cv::InputArray frame, int index);
+    
+    // Decimal map (phase order) as in decimalMap
+    void finalize(cv::OutputArray dec) const;
+    
+    // Bit-packed code word as in graycodewordPacked (n <= 16)
+    void codeWord(cv::OutputArray code_word) const;
+    
+    // Number of graycode images pushed since the construction or the last reset
+    int count() const { return n_frames; }
+    
+    void reset();
+
+private:
+    int n;
+    int n_frames = 0;
+    std::vector<bool> pushed;
+    std::vector<cv::Mat> pending; // first image of the pairs whose counterpart has not arrived
+    cv::Mat gray; // packed gray words (CV_32S)
+};
+
+
+// Finalize the accumulators and unwrap the phase as phaseGraycodingUnwrap. The accumulators decode
+// all the pixels, and the optional mask only restricts the unwrapping
+void phaseGraycodingUnwrap(const PhaseShiftAccumulator& ps, const GrayCodeAccumulator& gc,
+                           cv::OutputArray Phi, int p, Workspace* ws = nullptr,
+                           cv::InputArray mask = cv::noArray());
+
+// Finalize the accumulators of each frequency and unwrap the phase as threeFreqPhaseUnwrap
+void threeFreqPhaseUnwrap(const PhaseShiftAccumulator& ps1, const PhaseShiftAccumulator& ps2,
+                          const PhaseShiftAccumulator& ps3, cv::OutputArray Phi, const cv::Vec3i& p,
+                          Workspace* ws = nullptr, cv::InputArray mask = cv::noArray());
+
+// Finalize the accumulators of each frequency and unwrap the phase as twoFreqPhaseUnwrap
+void twoFreqPhaseUnwrap(const PhaseShiftAccumulator& ps1, const PhaseShiftAccumulator& ps2,
+                        cv::OutputArray Phi, const cv::Vec3i& p, Workspace* ws = nullptr,
+                        cv::InputArray mask = cv::noArray());
+
+} // namespace sl
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <cstddef>
+#include <vector>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+Reusable storage for the intermediate arrays of the library functions. When
+the same workspace is passed to repeated calls with the same image size,
+number of patterns and dtype, only the first call allocates the intermediate
+arrays and later calls reuse them. Pass also the same output arrays to avoid
+reallocating the outputs. A workspace must not be shared by concurrent calls.
+--------------------------------------------------------------------------- */
+class Workspace {
+public:
+    static constexpr int NUM_BUFFERS = 24;
+    
+    // Buffer used by the library functions for the intermediate array `slot`
+    cv::Mat& buffer(int slot);
+    
+    // List of frame headers of the input image stack (no pixel data is stored)
+    std::vector<cv::Mat>& frames() { return frame_list; }
+    
+    // Total size in bytes of the allocated buffers
+    std::size_t memoryUsage() const;
+    
+    // Release all the buffers
+    void release();
+
+private:
+    cv::Mat buffers[NUM_BUFFERS];
+    std::vector<cv::Mat> frame_list;
+};
+
+} // namespace sl
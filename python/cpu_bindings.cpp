@@ -1,15 +1,25 @@
+#include <SLutils/batch.hpp>
 #include <SLutils/centerline.hpp>
+#include <SLutils/config.hpp>
 #include <SLutils/fringe_analysis.hpp>
 #include <SLutils/graycoding.hpp>
+#include <SLutils/patterns.hpp>
 #include <SLutils/phase_graycoding.hpp>
+#include <SLutils/stats.hpp>
+#include <SLutils/streaming.hpp>
 
 #include <vector>
 #include <string>
+#include <optional>
+#include <stdexcept> // std::runtime_error
+#include <tuple>
 #include <utility> // std::pair
 
 #include <nanobind/nanobind.h>
 #include <nanobind/ndarray.h>
+#include <nanobind/stl/optional.h>
 #include <nanobind/stl/pair.h>
+#include <nanobind/stl/tuple.h>
 #include <nanobind/stl/vector.h>
 #include <nanobind/stl/string.h>
 
@@ -65,6 +75,67 @@ nb::ndarray<nb::numpy, double> bind_spatialUnwrap(nb::ndarray<double, nb::ndim<2
     return {Phi.data, {h, w}, owner};
 }
 
+nb::ndarray<nb::numpy, double> bind_spatialUnwrapScanline(nb::ndarray<double, nb::ndim<2>> _phased,
+                                                          nb::ndarray<int, nb::shape<2>> p0,
+                                                          nb::ndarray<uchar, nb::ndim<2>> _mask) {
+    
+    // Get array size
+    const size_t h = _phased.shape(0), w = _phased.shape(1);
+    
+    // Create cv::Mat views
+    cv::Mat phased(h, w, CV_64F, _phased.data());
+    cv::Mat mask(h, w, CV_8U, _mask.data());
+    
+    // Run core function
+    cv::Mat Phi;
+    sl::spatialUnwrapScanline(phased, {p0(0), p0(1)}, mask, Phi);
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+    
+    return {Phi.data, {h, w}, owner};
+}
+
+nb::ndarray<nb::numpy, double> bind_qualityGuidedUnwrap(nb::ndarray<double, nb::ndim<2>> _phased,
+                                                        nb::ndarray<double, nb::ndim<2>> _quality,
+                                                        nb::ndarray<int, nb::shape<2>> p0,
+                                                        nb::ndarray<uchar, nb::ndim<2>> _mask) {
+    
+    // Get array size
+    const size_t h = _phased.shape(0), w = _phased.shape(1);
+    
+    // Create cv::Mat views
+    cv::Mat phased(h, w, CV_64F, _phased.data());
+    cv::Mat quality(_quality.shape(0), _quality.shape(1), CV_64F, _quality.data());
+    cv::Mat mask(h, w, CV_8U, _mask.data());
+    
+    // Run core function
+    cv::Mat Phi;
+    sl::qualityGuidedUnwrap(phased, quality, {p0(0), p0(1)}, mask, Phi);
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+    
+    return {Phi.data, {h, w}, owner};
+}
+
+nb::ndarray<nb::numpy, double> bind_phaseDerivativeVariance(nb::ndarray<double, nb::ndim<2>> _phased, int ksize) {
+    // Get array size
+    const size_t h = _phased.shape(0), w = _phased.shape(1);
+    
+    // Create cv::Mat view
+    cv::Mat phased(h, w, CV_64F, _phased.data());
+    
+    // Run core function
+    cv::Mat pdv;
+    sl::phaseDerivativeVariance(phased, pdv, ksize);
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(pdv), delete_Mat);
+    
+    return {pdv.data, {h, w}, owner};
+}
+
 
 /* ----------------------- Bindings for fringe_analysis.hpp ----------------------- */
 nb::ndarray<nb::numpy, double> bind_NStepPhaseShifting(const std::vector<std::string>& imgs, int N) {
@@ -157,6 +228,35 @@ nb::ndarray<nb::numpy, uchar> bind_graycodeword(const std::vector<std::string>&
     return {code_word.data, {n, h, w}, owner};
 }
 
+nb::ndarray<nb::numpy, ushort> bind_graycodewordPacked(const std::vector<std::string>& imlist) {
+    // Run core function
+    cv::Mat code_word;
+    sl::graycodewordPacked(imlist, code_word); // returns ushort 2D array
+    
+    // Get output size
+    const size_t h = code_word.rows, w = code_word.cols;
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(code_word), delete_Mat);
+    
+    return {code_word.data, {h, w}, owner};
+}
+
+nb::ndarray<nb::numpy, int> bind_gray2dec_packed(nb::ndarray<ushort, nb::ndim<2>, nb::c_contig> _code_word) {
+    // Create cv::Mat view
+    const size_t h = _code_word.shape(0), w = _code_word.shape(1);
+    cv::Mat code_word(h, w, CV_16U, _code_word.data());
+    
+    // Run core function
+    cv::Mat dec;
+    sl::gray2dec(code_word, dec); // returns int 2D array
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(dec), delete_Mat);
+    
+    return {dec.data, {h, w}, owner};
+}
+
 nb::ndarray<nb::numpy, int> bind_gray2dec(nb::ndarray<uchar, nb::ndim<3>> _code_word) {
     // Create cv::Mat view
     const size_t n = _code_word.shape(0), h = _code_word.shape(1), w = _code_word.shape(2);
@@ -192,14 +292,384 @@ nb::ndarray<nb::numpy, double> bind_phaseGraycodingUnwrap(const std::vector<std:
     return {Phi.data, {h, w}, owner};
 }
 
+nb::ndarray<nb::numpy, double> bind_complementaryGraycodingUnwrap(const std::vector<std::string>& imlist_ps,
+                                                                  const std::vector<std::string>& imlist_gc,
+                                                                  int N) {
+    
+    // Run core function
+    cv::Mat Phi;
+    sl::complementaryGraycodingUnwrap(imlist_ps, imlist_gc, Phi, N);
+    
+    // Get output size
+    const size_t h = Phi.rows, w = Phi.cols;
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+    
+    return {Phi.data, {h, w}, owner};
+}
+
+
+
+/* ----------------------- Bindings for in-memory frame stacks ----------------------- */
+// (n,h,w) uint8 stack of frames, e.g. from generateFringes or a camera buffer
+using FrameArray = nb::ndarray<const uchar, nb::ndim<3>, nb::c_contig, nb::device::cpu>;
+
+// Caller-provided (h,w) output array
+template <typename T>
+using OutArray = nb::ndarray<nb::numpy, T, nb::ndim<2>, nb::c_contig>;
+
+// Optional (h,w) uint8 mask of the valid pixels
+using MaskArray = nb::ndarray<const uchar, nb::ndim<2>, nb::c_contig, nb::device::cpu>;
+
+// cv::Mat view of a frame stack, which the decoders read without copying
+cv::Mat stackView(const FrameArray& frames) {
+    const int sizes[] = {int(frames.shape(0)), int(frames.shape(1)), int(frames.shape(2))};
+    return cv::Mat(3, sizes, CV_8U, const_cast<uchar*>(frames.data()));
+}
+
+// cv::Mat view of an optional output array of size (h,w). Since its size and type are the ones of the
+// result, the decoders write directly into it. Returns an empty cv::Mat when there is no output array
+template <typename T>
+cv::Mat outputView(std::optional<OutArray<T>>& out, const FrameArray& frames) {
+    if (!out)
+        return cv::Mat();
+    
+    if (out->shape(0) != frames.shape(1) or out->shape(1) != frames.shape(2))
+        throw std::runtime_error("the output array must have the (h,w) size of the frames");
+    return cv::Mat(int(out->shape(0)), int(out->shape(1)), cv::traits::Depth<T>::value, out->data());
+}
+
+// cv::Mat view of an optional mask. Returns an empty cv::Mat (all the pixels) when there is no mask
+cv::Mat maskView(const std::optional<MaskArray>& mask) {
+    if (!mask)
+        return cv::Mat();
+    
+    return cv::Mat(int(mask->shape(0)), int(mask->shape(1)), CV_8U, const_cast<uchar*>(mask->data()));
+}
+
+// Return the output array when it was given, otherwise a new numpy array that owns the result
+template <typename T>
+nb::object outputArray(std::optional<OutArray<T>>& out, const cv::Mat& result) {
+    if (out) {
+        if (result.data != out->data())
+            throw std::runtime_error("the result was not written to the output array");
+        return nb::cast(*out);
+    }
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(result), delete_Mat);
+    
+    return nb::cast(nb::ndarray<nb::numpy, T>(result.data, {size_t(result.rows), size_t(result.cols)}, owner));
+}
+
+nb::object bind_NStepPhaseShifting_array(const FrameArray& frames, int N, std::optional<OutArray<double>> out,
+                                         std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), phi = outputView(out, frames);
+    {
+        // Release the GIL so that other Python threads can run other scans meanwhile
+        nb::gil_scoped_release release;
+        sl::NStepPhaseShifting(images, phi, N, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return outputArray(out, phi);
+}
+
+std::pair<nb::object, nb::object> bind_NStepPhaseShifting_modulation_array(const FrameArray& frames, int N,
+                                                                           std::optional<OutArray<double>> out,
+                                                                           std::optional<OutArray<double>> out_modulation,
+                                                                           std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), phi = outputView(out, frames), mod = outputView(out_modulation, frames);
+    {
+        nb::gil_scoped_release release;
+        sl::NStepPhaseShifting_modulation(images, phi, mod, N, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return {outputArray(out, phi), outputArray(out_modulation, mod)};
+}
+
+std::pair<nb::object, nb::object> bind_NStepPhaseShifting_valid_array(const FrameArray& frames, int N,
+                                                                      const sl::ValidityCriteria& criteria,
+                                                                      std::optional<OutArray<double>> out,
+                                                                      std::optional<OutArray<uchar>> out_valid,
+                                                                      std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), phi = outputView(out, frames), valid = outputView(out_valid, frames);
+    {
+        nb::gil_scoped_release release;
+        sl::NStepPhaseShifting_valid(images, phi, valid, N, criteria, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return {outputArray(out, phi), outputArray(out_valid, valid)};
+}
+
+nb::object bind_ThreeStepPhaseShifting_array(const FrameArray& frames, std::optional<OutArray<double>> out,
+                                             std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), phi = outputView(out, frames);
+    {
+        nb::gil_scoped_release release;
+        sl::ThreeStepPhaseShifting(images, phi, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return outputArray(out, phi);
+}
+
+std::pair<nb::object, nb::object> bind_ThreeStepPhaseShifting_modulation_array(const FrameArray& frames,
+                                                                               std::optional<OutArray<double>> out,
+                                                                               std::optional<OutArray<double>> out_modulation,
+                                                                               std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), phi = outputView(out, frames), mod = outputView(out_modulation, frames);
+    {
+        nb::gil_scoped_release release;
+        sl::ThreeStepPhaseShifting_modulation(images, phi, mod, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return {outputArray(out, phi), outputArray(out_modulation, mod)};
+}
+
+nb::object bind_decimalMap_array(const FrameArray& frames, std::optional<OutArray<int>> out,
+                                 std::optional<MaskArray> mask) {
+    cv::Mat images = stackView(frames), dec = outputView(out, frames);
+    {
+        nb::gil_scoped_release release;
+        sl::decimalMap(images, dec, nullptr, maskView(mask));
+    }
+    
+    return outputArray(out, dec);
+}
+
+nb::object bind_phaseGraycodingUnwrap_array(const FrameArray& frames_ps, const FrameArray& frames_gc, int p, int N,
+                                            std::optional<OutArray<double>> out, std::optional<MaskArray> mask) {
+    cv::Mat images_ps = stackView(frames_ps), images_gc = stackView(frames_gc), Phi = outputView(out, frames_ps);
+    {
+        nb::gil_scoped_release release;
+        sl::phaseGraycodingUnwrap(images_ps, images_gc, Phi, p, N, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return outputArray(out, Phi);
+}
+
+nb::object bind_complementaryGraycodingUnwrap_array(const FrameArray& frames_ps, const FrameArray& frames_gc, int N,
+                                                    std::optional<OutArray<double>> out, std::optional<MaskArray> mask) {
+    cv::Mat images_ps = stackView(frames_ps), images_gc = stackView(frames_gc), Phi = outputView(out, frames_ps);
+    {
+        nb::gil_scoped_release release;
+        sl::complementaryGraycodingUnwrap(images_ps, images_gc, Phi, N, CV_64F, nullptr, maskView(mask));
+    }
+    
+    return outputArray(out, Phi);
+}
+
+std::pair<nb::object, nb::object> bind_phaseGraycodingUnwrap_valid_array(const FrameArray& frames_ps,
+                                                                         const FrameArray& frames_gc, int p, int N,
+                                                                         const sl::ValidityCriteria& criteria,
+                                                                         std::optional<OutArray<double>> out,
+                                                                         std::optional<OutArray<uchar>> out_valid,
+                                                                         std::optional<MaskArray> mask) {
+    cv::Mat images_ps = stackView(frames_ps), images_gc = stackView(frames_gc);
+    cv::Mat Phi = outputView(out, frames_ps), valid = outputView(out_valid, frames_ps);
+    {
+        nb::gil_scoped_release release;
+        sl::phaseGraycodingUnwrap_valid(images_ps, images_gc, Phi, valid, p, N, criteria, CV_64F, nullptr,
+                                        maskView(mask));
+    }
+    
+    return {outputArray(out, Phi), outputArray(out_valid, valid)};
+}
+
+
+
+/* ----------------------- Bindings for patterns.hpp ----------------------- */
+// Wrap a (n,h,w) CV_8U pattern stack as a numpy array
+nb::ndarray<nb::numpy, uchar> patternStack(const cv::Mat& patterns) {
+    // Get output size
+    const size_t n = patterns.size[0], h = patterns.size[1], w = patterns.size[2];
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(patterns), delete_Mat);
+    
+    return {patterns.data, {n, h, w}, owner};
+}
+
+nb::ndarray<nb::numpy, uchar> bind_generateFringes(double period, int N, int w, int h, const sl::PatternModel& model) {
+    cv::Mat patterns;
+    sl::generateFringes(period, N, {w, h}, patterns, model);
+    return patternStack(patterns);
+}
+
+nb::ndarray<nb::numpy, uchar> bind_generateMultiFreqFringes(const std::vector<std::pair<int, int>>& freqs, int w,
+                                                            int h, const sl::PatternModel& model) {
+    std::vector<cv::Vec2i> vfreqs;
+    for (auto [p, N] : freqs)
+        vfreqs.push_back({p, N});
+    
+    cv::Mat patterns;
+    sl::generateMultiFreqFringes(vfreqs, {w, h}, patterns, model);
+    return patternStack(patterns);
+}
+
+nb::ndarray<nb::numpy, uchar> bind_generateGrayCode(int nbits, int w, int h, bool inverted, int period,
+                                                    const sl::PatternModel& model) {
+    cv::Mat patterns;
+    sl::generateGrayCode(nbits, {w, h}, inverted, patterns, period, model);
+    return patternStack(patterns);
+}
+
+
+
+/* ----------------------- Bindings for stats.hpp ----------------------- */
+// Statistics as a dict: {stage name: {"time_ms", "calls", "bytes"}, "allocations", "allocated_bytes",
+// "spike_corrections", "spike_candidates"}
+nb::dict bind_getStats() {
+    const sl::Stats stats = sl::getStats();
+    
+    nb::dict out;
+    for (int s = 0; s < sl::STATS_NUM_STAGES; s++) {
+        nb::dict stage;
+        stage["time_ms"] = stats.stages[s].time_ms;
+        stage["calls"] = stats.stages[s].calls;
+        stage["bytes"] = stats.stages[s].bytes;
+        out[sl::statsStageName(static_cast<sl::StatsStage>(s))] = stage;
+    }
+    out["allocations"] = stats.allocations;
+    out["allocated_bytes"] = stats.allocated_bytes;
+    out["spike_corrections"] = stats.spike_corrections;
+    out["spike_candidates"] = stats.spike_candidates;
+    
+    return out;
+}
+
+
+
+/* ----------------------- Bindings for batch.hpp ----------------------- */
+// Each scan is a (imlist_ps, imlist_gc, p, N) tuple. When given, callback(i, Phi) is called as
+// soon as the scan i is unwrapped
+nb::list bind_phaseGraycodingUnwrapBatch(
+    const std::vector<std::tuple<std::vector<std::string>, std::vector<std::string>, int, int>>& scan_list,
+    nb::object callback) {
+    
+    std::vector<sl::PhaseGraycodingScan> scans(scan_list.size());
+    for (size_t i = 0; i < scans.size(); i++) {
+        auto& [imlist_ps, imlist_gc, p, N] = scan_list[i];
+        scans[i] = {imlist_ps, imlist_gc, p, N};
+    }
+    
+    std::vector<cv::Mat> Phis(scans.size());
+    {
+        // Release the GIL while the scans are processed, and take it back only for the callback
+        nb::gil_scoped_release release;
+        sl::phaseGraycodingUnwrapBatch(scans, [&](int i, const cv::Mat& Phi) {
+            Phis[i] = Phi;
+            if (!callback.is_none()) {
+                nb::gil_scoped_acquire acquire;
+                nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+                callback(i, nb::ndarray<nb::numpy, double>(Phi.data, {size_t(Phi.rows), size_t(Phi.cols)}, owner));
+            }
+        });
+    }
+    
+    // Create the output numpy arrays, sharing the data with the ones passed to the callback
+    nb::list out;
+    for (const cv::Mat& Phi : Phis) {
+        nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+        out.append(nb::ndarray<nb::numpy, double>(Phi.data, {size_t(Phi.rows), size_t(Phi.cols)}, owner));
+    }
+    
+    return out;
+}
+
+
+
+/* ----------------------- Bindings for streaming.hpp ----------------------- */
+void bind_PhaseShiftAccumulator_push(sl::PhaseShiftAccumulator& acc,
+                                     nb::ndarray<uchar, nb::ndim<2>, nb::c_contig> _frame, int index) {
+    // Create cv::Mat view
+    const size_t h = _frame.shape(0), w = _frame.shape(1);
+    cv::Mat frame(h, w, CV_8U, _frame.data());
+    
+    acc.push(frame, index);
+}
+
+auto bind_PhaseShiftAccumulator_finalize(const sl::PhaseShiftAccumulator& acc)
+  -> std::pair<nb::ndarray<nb::numpy, double>, nb::ndarray<nb::numpy, double>> {
+    // Run core function
+    cv::Mat phi, mod;
+    acc.finalize(phi, mod);
+    
+    // Get output size
+    const size_t h = phi.rows, w = phi.cols;
+    
+    // Create capsules for output numpy arrays
+    nb::capsule owner_phi(new cv::Mat(phi), delete_Mat);
+    nb::capsule owner_mod(new cv::Mat(mod), delete_Mat);
+    
+    return {{phi.data, {h, w}, owner_phi}, {mod.data, {h, w}, owner_mod}};
+}
+
+void bind_GrayCodeAccumulator_push(sl::GrayCodeAccumulator& acc,
+                                   nb::ndarray<uchar, nb::ndim<2>, nb::c_contig> _frame, int index) {
+    // Create cv::Mat view
+    const size_t h = _frame.shape(0), w = _frame.shape(1);
+    cv::Mat frame(h, w, CV_8U, _frame.data());
+    
+    acc.push(frame, index);
+}
+
+nb::ndarray<nb::numpy, int> bind_GrayCodeAccumulator_finalize(const sl::GrayCodeAccumulator& acc) {
+    // Run core function
+    cv::Mat dec;
+    acc.finalize(dec); // returns int 2D array
+    
+    // Get output size
+    const size_t h = dec.rows, w = dec.cols;
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(dec), delete_Mat);
+    
+    return {dec.data, {h, w}, owner};
+}
+
+nb::ndarray<nb::numpy, double> bind_phaseGraycodingUnwrap_acc(const sl::PhaseShiftAccumulator& ps,
+                                                              const sl::GrayCodeAccumulator& gc, int p) {
+    // Run core function
+    cv::Mat Phi;
+    sl::phaseGraycodingUnwrap(ps, gc, Phi, p);
+    
+    // Get output size
+    const size_t h = Phi.rows, w = Phi.cols;
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::Mat(Phi), delete_Mat);
+    
+    return {Phi.data, {h, w}, owner};
+}
+
 
 
 /////////////////////////////////////////////////////////////////////
 /* ----------------------- Create bindings ----------------------- */
 /////////////////////////////////////////////////////////////////////
 NB_MODULE(sl, m) {
+    m.def("setNumThreads", &sl::setNumThreads);
+    m.def("getNumThreads", &sl::getNumThreads);
+    
+    nb::enum_<sl::PhaseAccuracy>(m, "PhaseAccuracy")
+        .value("EXACT", sl::PHASE_ACCURACY_EXACT)
+        .value("FAST", sl::PHASE_ACCURACY_FAST)
+        .export_values();
+    m.def("setPhaseAccuracy", &sl::setPhaseAccuracy);
+    m.def("getPhaseAccuracy", &sl::getPhaseAccuracy);
+    m.def("setPhaseLUT", &sl::setPhaseLUT);
+    m.def("getPhaseLUT", &sl::getPhaseLUT);
+    
+    m.def("statsEnabled", &sl::statsEnabled);
+    m.def("getStats", bind_getStats);
+    m.def("resetStats", &sl::resetStats);
+    
     m.def("seedPoint", bind_seedPoint);
     m.def("spatialUnwrap", bind_spatialUnwrap);
+    m.def("spatialUnwrapScanline", bind_spatialUnwrapScanline);
+    m.def("qualityGuidedUnwrap", bind_qualityGuidedUnwrap);
+    m.def("phaseDerivativeVariance", bind_phaseDerivativeVariance, nb::arg("phased"), nb::arg("ksize") = 3);
     
     m.def("NStepPhaseShifting", bind_NStepPhaseShifting);
     m.def("NStepPhaseShifting_modulation", bind_NStepPhaseShifting_modulation);
@@ -209,7 +679,85 @@ NB_MODULE(sl, m) {
     
     m.def("decimalMap", bind_decimalMap);
     m.def("graycodeword", bind_graycodeword);
+    m.def("graycodewordPacked", bind_graycodewordPacked);
     m.def("gray2dec", bind_gray2dec);
+    m.def("gray2dec", bind_gray2dec_packed);
     
     m.def("phaseGraycodingUnwrap", bind_phaseGraycodingUnwrap);
+    m.def("complementaryGraycodingUnwrap", bind_complementaryGraycodingUnwrap);
+    
+    
+    // In-memory (n,h,w) uint8 frame stacks with optional preallocated outputs
+    // and an optional (h,w) uint8 mask of the valid pixels. The arrays are never
+    // converted or copied: a wrong dtype or a non-contiguous array raises TypeError
+    m.def("NStepPhaseShifting", bind_NStepPhaseShifting_array, nb::arg("frames").noconvert(), nb::arg("N"),
+          nb::arg("out").noconvert() = nb::none(), nb::arg("mask").noconvert() = nb::none());
+    m.def("NStepPhaseShifting_modulation", bind_NStepPhaseShifting_modulation_array, nb::arg("frames").noconvert(),
+          nb::arg("N"), nb::arg("out").noconvert() = nb::none(), nb::arg("out_modulation").noconvert() = nb::none(),
+          nb::arg("mask").noconvert() = nb::none());
+    m.def("ThreeStepPhaseShifting", bind_ThreeStepPhaseShifting_array, nb::arg("frames").noconvert(),
+          nb::arg("out").noconvert() = nb::none(), nb::arg("mask").noconvert() = nb::none());
+    m.def("ThreeStepPhaseShifting_modulation", bind_ThreeStepPhaseShifting_modulation_array,
+          nb::arg("frames").noconvert(), nb::arg("out").noconvert() = nb::none(),
+          nb::arg("out_modulation").noconvert() = nb::none(), nb::arg("mask").noconvert() = nb::none());
+    m.def("decimalMap", bind_decimalMap_array, nb::arg("frames").noconvert(), nb::arg("out").noconvert() = nb::none(),
+          nb::arg("mask").noconvert() = nb::none());
+    m.def("phaseGraycodingUnwrap", bind_phaseGraycodingUnwrap_array, nb::arg("frames_ps").noconvert(),
+          nb::arg("frames_gc").noconvert(), nb::arg("p"), nb::arg("N"), nb::arg("out").noconvert() = nb::none(),
+          nb::arg("mask").noconvert() = nb::none());
+    m.def("complementaryGraycodingUnwrap", bind_complementaryGraycodingUnwrap_array, nb::arg("frames_ps").noconvert(),
+          nb::arg("frames_gc").noconvert(), nb::arg("N"), nb::arg("out").noconvert() = nb::none(),
+          nb::arg("mask").noconvert() = nb::none());
+    
+    // Validity mask computed in the phase pass, returned with the phase as a uint8 array
+    nb::class_<sl::ValidityCriteria>(m, "ValidityCriteria")
+        .def(nb::init<>())
+        .def_rw("min_modulation", &sl::ValidityCriteria::min_modulation)
+        .def_rw("saturation", &sl::ValidityCriteria::saturation);
+    
+    m.def("NStepPhaseShifting_valid", bind_NStepPhaseShifting_valid_array, nb::arg("frames").noconvert(), nb::arg("N"),
+          nb::arg("criteria") = sl::ValidityCriteria(), nb::arg("out").noconvert() = nb::none(),
+          nb::arg("out_valid").noconvert() = nb::none(), nb::arg("mask").noconvert() = nb::none());
+    m.def("phaseGraycodingUnwrap_valid", bind_phaseGraycodingUnwrap_valid_array, nb::arg("frames_ps").noconvert(),
+          nb::arg("frames_gc").noconvert(), nb::arg("p"), nb::arg("N"), nb::arg("criteria") = sl::ValidityCriteria(),
+          nb::arg("out").noconvert() = nb::none(), nb::arg("out_valid").noconvert() = nb::none(),
+          nb::arg("mask").noconvert() = nb::none());
+    
+    
+    nb::class_<sl::PatternModel>(m, "PatternModel")
+        .def(nb::init<>())
+        .def_rw("offset", &sl::PatternModel::offset)
+        .def_rw("amplitude", &sl::PatternModel::amplitude)
+        .def_rw("gamma", &sl::PatternModel::gamma)
+        .def_rw("defocus", &sl::PatternModel::defocus)
+        .def_rw("noise", &sl::PatternModel::noise)
+        .def_rw("seed", &sl::PatternModel::seed);
+    
+    m.def("generateFringes", bind_generateFringes, nb::arg("period"), nb::arg("N"), nb::arg("width"),
+          nb::arg("height"), nb::arg("model") = sl::PatternModel());
+    m.def("generateMultiFreqFringes", bind_generateMultiFreqFringes, nb::arg("freqs"), nb::arg("width"),
+          nb::arg("height"), nb::arg("model") = sl::PatternModel());
+    m.def("generateGrayCode", bind_generateGrayCode, nb::arg("nbits"), nb::arg("width"), nb::arg("height"),
+          nb::arg("inverted") = true, nb::arg("period") = 0, nb::arg("model") = sl::PatternModel());
+    
+    
+    nb::class_<sl::PhaseShiftAccumulator>(m, "PhaseShiftAccumulator")
+        .def(nb::init<int>())
+        .def("push", bind_PhaseShiftAccumulator_push)
+        .def("finalize", bind_PhaseShiftAccumulator_finalize)
+        .def("count", &sl::PhaseShiftAccumulator::count)
+        .def("reset", &sl::PhaseShiftAccumulator::reset);
+    
+    nb::class_<sl::GrayCodeAccumulator>(m, "GrayCodeAccumulator")
+        .def(nb::init<int>())
+        .def("push", bind_GrayCodeAccumulator_push)
+        .def("finalize", bind_GrayCodeAccumulator_finalize)
+        .def("count", &sl::GrayCodeAccumulator::count)
+        .def("reset", &sl::GrayCodeAccumulator::reset);
+    
+    m.def("phaseGraycodingUnwrap", bind_phaseGraycodingUnwrap_acc);
+    
+    
+    m.def("phaseGraycodingUnwrapBatch", bind_phaseGraycodingUnwrapBatch, nb::arg("scans"),
+          nb::arg("callback") = nb::none());
 }
@@ -184,6 +184,24 @@ nb::ndarray<nb::pytorch, double> bind_phaseGraycodingUnwrap(const std::vector<st
         nb::dtype<double>(), nb::device::cuda::value};
 }
 
+nb::ndarray<nb::pytorch, double> bind_complementaryGraycodingUnwrap(const std::vector<std::string>& imlist_ps,
+                                                                    const std::vector<std::string>& imlist_gc,
+                                                                    int N) {
+    
+    // Run core function
+    cv::cuda::GpuMat Phi;
+    sl::complementaryGraycodingUnwrap(imlist_ps, imlist_gc, Phi, N);
+    
+    // Get output size
+    const size_t h = Phi.rows, w = Phi.cols;
+    
+    // Create capsule for the output numpy array
+    nb::capsule owner(new cv::cuda::GpuMat(Phi), delete_GpuMat);
+    
+    return {Phi.data, {h, w}, owner, {static_cast<int64_t>(Phi.step1()), 1},
+        nb::dtype<double>(), nb::device::cuda::value};
+}
+
 
 
 /////////////////////////////////////////////////////////////////////
@@ -201,4 +219,5 @@ NB_MODULE(sl, m) {
     m.def("gray2dec", bind_gray2dec);
     
     m.def("phaseGraycodingUnwrap", bind_phaseGraycodingUnwrap);
+    m.def("complementaryGraycodingUnwrap", bind_complementaryGraycodingUnwrap);
 }
@@ -0,0 +1,152 @@
+#include <SLutils/batch.hpp>
+#include <SLutils/config.hpp> // getNumThreads
+#include <SLutils/phase_graycoding.hpp>
+#include <SLutils/workspace.hpp>
+
+#include "frames.hpp" // readImages
+
+#include <opencv2/core/utility.hpp> // cv::parallel_for_
+#include <opencv2/imgcodecs.hpp> // cv::imread
+
+#include <algorithm> // std::min
+#include <atomic>
+#include <cstddef> // std::size_t
+#include <exception> // std::exception_ptr
+#include <memory> // std::unique_ptr
+#include <mutex>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+Workspaces of the scans in flight. Each running scan takes a workspace and
+gives it back when done, so at most one workspace per thread is allocated and
+the intermediate arrays are reused by the following scans of that size.
+--------------------------------------------------------------------------- */
+class WorkspacePool {
+public:
+    std::unique_ptr<Workspace> acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free.empty())
+            return std::make_unique<Workspace>();
+        
+        std::unique_ptr<Workspace> ws = std::move(free.back());
+        free.pop_back();
+        return ws;
+    }
+    
+    void release(std::unique_ptr<Workspace> ws) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(std::move(ws));
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Workspace>> free;
+};
+
+// Scans with at least this many pixels are split in row bands, smaller ones are processed
+// concurrently with one whole scan per thread
+constexpr std::size_t MIN_SPLIT_PIXELS = std::size_t(1) << 20;
+
+// Number of pixels of a scan: the size of its mask, or else of its first phase-shifting image.
+// Unreadable images give 0 and are reported when the scan is processed
+static std::size_t scanPixels(const PhaseGraycodingScan& scan) {
+    if (!scan.mask.empty())
+        return scan.mask.total();
+    if (scan.impaths_ps.empty())
+        return 0;
+    
+    try {
+        return cv::imread(scan.impaths_ps[0], 0).total();
+    }
+    catch (const cv::Exception&) {
+        return 0;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+Run body(i) for each i in [0, n) with min(n, sl::getNumThreads()) stripes on
+the OpenCV thread pool. Each stripe pulls the next pending index until none
+is left, so the idle threads take the remaining work whatever its cost, and
+no more than sl::getNumThreads() indices are processed at a time.
+--------------------------------------------------------------------------- */
+template <typename Body>
+static void forEachDynamic(int n, const Body& body) {
+    const int nstripes = std::min(n, getNumThreads());
+    if (nstripes <= 1) {
+        for (int i = 0; i < n; i++)
+            body(i);
+        return;
+    }
+    
+    std::atomic<int> next{0};
+    cv::parallel_for_(cv::Range(0, nstripes), [&](const cv::Range&) {
+        for (int i = next++; i < n; i = next++)
+            body(i);
+    }, nstripes);
+}
+
+void phaseGraycodingUnwrapBatch(const std::vector<PhaseGraycodingScan>& scans,
+                                const std::function<void(int, const cv::Mat&)>& on_result, int dtype) {
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrapBatch");
+    
+    const int nscans = static_cast<int>(scans.size());
+    WorkspacePool pool;
+    std::mutex result_mutex;
+    std::exception_ptr error;
+    
+    auto process = [&](int i) {
+        std::unique_ptr<Workspace> ws = pool.acquire();
+        try {
+            const PhaseGraycodingScan& scan = scans[i];
+            auto [images_ps, images_gc] = detail::readImages(scan.impaths_ps, scan.impaths_gc);
+            
+            cv::Mat Phi;
+            phaseGraycodingUnwrap(images_ps, images_gc, Phi, scan.p, scan.N, dtype, ws.get(), scan.mask);
+            
+            std::lock_guard<std::mutex> lock(result_mutex);
+            on_result(i, Phi);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        pool.release(std::move(ws));
+    };
+    
+    // Sort the scans by size. Probing the size of the scans without a mask decodes one image each
+    std::vector<std::size_t> pixels(nscans);
+    forEachDynamic(nscans, [&](int i) {
+        pixels[i] = scanPixels(scans[i]);
+    });
+    
+    std::vector<int> small, large;
+    for (int i = 0; i < nscans; i++)
+        (pixels[i] < MIN_SPLIT_PIXELS ? small : large).push_back(i);
+    
+    // Small scans together, one whole scan per thread. The nested parallel loops of each scan then
+    // run serially on its thread
+    forEachDynamic(static_cast<int>(small.size()), [&](int k) {
+        process(small[k]);
+    });
+    
+    // Large scans one after the other, each split in row bands as in the single-scan functions
+    for (int i : large)
+        process(i);
+    
+    if (error)
+        std::rethrow_exception(error);
+}
+
+std::vector<cv::Mat> phaseGraycodingUnwrapBatch(const std::vector<PhaseGraycodingScan>& scans, int dtype) {
+    std::vector<cv::Mat> Phis(scans.size());
+    phaseGraycodingUnwrapBatch(scans, [&](int i, const cv::Mat& Phi) {
+        Phis[i] = Phi;
+    }, dtype);
+    
+    return Phis;
+}
+
+} // namespace sl
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SLutils/workspace.hpp>
+
+#include "stats.hpp" // recordAllocation
+
+#include <opencv2/core/mat.hpp>
+#include <vector>
+
+
+namespace sl::detail {
+
+// Workspace buffers of the intermediate arrays. Functions that call each other use different slots
+enum WorkspaceSlot {
+    WS_PHASE1, WS_PHASE2, WS_PHASE3, // wrapped phase maps
+    WS_PHASE_STACK, // wrapped phase maps of the multi-frequency unwrapping
+    WS_TILES_WIDE, WS_TILES_MEDIAN, // tile buffers of the fused multi-frequency unwrapping
+    WS_ORDER, WS_ORDER_PHASE, // phase order map (CV_32S) and its floating-point version
+    WS_VALID, WS_VALID_EXTENTS, // validity mask and the column extents of its rows
+    WS_TILE_OCCUPIED, // tile occupancy of a mask, while its runs are built
+    WS_MASK_RUNS, WS_MASK_OFFSETS, // runs of occupied tiles of the mask and their offset per tile row
+    WS_VALID_RUNS, WS_VALID_OFFSETS, // runs of occupied tiles of the validity mask and their offsets
+    WS_TILES_RANGE, // column minima and maxima of the spike candidates of the fused multi-frequency unwrapping
+    WS_SPIKE_ROWS, // row buffers of each band of the spike removal
+    WS_CRT_TABLE // lookup table of the number-theoretic multi-frequency unwrapping
+};
+
+// Get an array of the given size and type from a workspace buffer, or a new array when there is
+// no workspace. The buffer is only reallocated when its size or type change
+inline cv::Mat getBuffer(Workspace* ws, int slot, cv::Size size, int type) {
+    if (!ws) {
+        if constexpr (STATS_ENABLED)
+            recordAllocation(static_cast<std::uint64_t>(size.area())*CV_ELEM_SIZE(type));
+        return cv::Mat(size, type);
+    }
+    
+    cv::Mat& buf = ws->buffer(slot);
+    const uchar* data = buf.data;
+    buf.create(size, type);
+    if constexpr (STATS_ENABLED) {
+        if (buf.data != data)
+            recordAllocation(buf.total()*buf.elemSize());
+    }
+    return buf;
+}
+
+// Get the frame list of a workspace, or `local` when there is no workspace
+inline std::vector<cv::Mat>& getFrameList(Workspace* ws, std::vector<cv::Mat>& local) {
+    return ws ? ws->frames() : local;
+}
+
+} // namespace sl::detail
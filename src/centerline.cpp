@@ -1,20 +1,36 @@
 #include <SLutils/centerline.hpp>
+#include <SLutils/config.hpp> // getNumThreads
 
+#include "parallel.hpp" // parallelForRows
+
+#include <opencv2/core/utility.hpp> // cv::parallel_for_
 #include <opencv2/imgcodecs.hpp> // cv::imread
 #include <opencv2/imgproc.hpp> // cv::threshold
 
+#include <algorithm> // std::min, std::max, std::clamp
+#include <cmath> // std::sqrt
 #include <queue>
 #include <stdexcept> // std::runtime_error
+#include <vector>
 
 
 namespace sl {
 
-cv::Point seedPoint(const std::string& fn_clx, const std::string& fn_cly, cv::InputArray _mask) {
+cv::Point seedPoint(const std::string& fn_clx, const std::string& fn_cly, cv::InputArray mask) {
     // Read center line images
     cv::Mat clx = cv::imread(fn_clx, 0);
     cv::Mat cly = cv::imread(fn_cly, 0);
+    
+    return seedPoint(clx, cly, mask);
+}
+
+cv::Point seedPoint(cv::InputArray _clx, cv::InputArray _cly, cv::InputArray _mask) {
+    // Get center line images
+    cv::Mat clx = _clx.getMat(), cly = _cly.getMat();
     if (clx.size != cly.size)
         throw std::runtime_error("seedPoint: center line images must have the same size");
+    if (clx.type() != CV_8UC1 or cly.type() != CV_8UC1)
+        throw std::runtime_error("seedPoint: center line images must be 8-bit single-channel arrays");
 
     // Get input mask
     cv::Mat mask = _mask.getMat();
@@ -22,14 +38,14 @@ cv::Point seedPoint(const std::string& fn_clx, const std::string& fn_cly, cv::In
         throw std::runtime_error("seedPoint: mask size must match center line image size");
     
     // Estimate vertical line
-    cv::bitwise_and(clx, mask, clx);
     cv::Mat bw1;
-    cv::threshold(clx, bw1, 0, 255, cv::THRESH_OTSU+cv::THRESH_BINARY);
+    cv::bitwise_and(clx, mask, bw1);
+    cv::threshold(bw1, bw1, 0, 255, cv::THRESH_OTSU+cv::THRESH_BINARY);
     
     // Estimate horizontal line
-    cv::bitwise_and(cly, mask, cly);
     cv::Mat bw2;
-    cv::threshold(cly, bw2, 0, 255, cv::THRESH_OTSU+cv::THRESH_BINARY);
+    cv::bitwise_and(cly, mask, bw2);
+    cv::threshold(bw2, bw2, 0, 255, cv::THRESH_OTSU+cv::THRESH_BINARY);
     
     // Estimate centroid of the intersection between both binary lines
     float sum_x = 0, sum_y = 0;
@@ -55,22 +71,13 @@ cv::Point seedPoint(const std::string& fn_clx, const std::string& fn_cly, cv::In
     return {x, y};
 }
 
-void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _mask, cv::OutputArray _Phi) {
+// Flood-fill unwrapping from p0 of a CV_32F (T = float) or CV_64F (T = double) phase map
+template <typename T>
+static cv::Mat spatialUnwrap(const cv::Mat& phased, const cv::Point p0, cv::Mat& mask) {
     // Define offsets
     constexpr int xo[8] = {-1, 0, 1,-1, 1,-1, 0, 1};
     constexpr int yo[8] = {-1,-1,-1, 0, 0, 1, 1, 1};
     
-    // Get input discontinuous phase map
-    cv::Mat phased = _phased.getMat();
-    if (p0.x < 0 or p0.x >= phased.cols or p0.y < 0 or p0.y >= phased.rows)
-        throw std::runtime_error("spatialUnwrap: invalid seed point (out of image bounds)");
-    
-    // Get an editable input mask (copy of the original mask)
-    cv::Mat mask;
-    _mask.copyTo(mask);
-    if (phased.size != mask.size)
-        throw std::runtime_error("spatialUnwrap: mask and discontinuous phase map must have the same size");
-    
     // Initialize output continuous phase map
     cv::Mat phasec = phased.clone();
     
@@ -79,8 +86,8 @@ void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _m
     queue.push(p0); // The first point is p0
     
     
-    const double* pphased = phased.ptr<double>();
-    double* pphasec = phasec.ptr<double>();
+    const T* pphased = phased.ptr<T>();
+    T* pphasec = phasec.ptr<T>();
     uchar* pmask = mask.data;
     
     // Remove p0 from the mask
@@ -96,8 +103,8 @@ void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _m
         queue.pop();
         
         // Get continuous and discontinuous phase values in p
-        const double PCI = pphasec[p.y*w + p.x];
-        const double PDI = pphased[p.y*w + p.x];
+        const T PCI = pphasec[p.y*w + p.x];
+        const T PDI = pphased[p.y*w + p.x];
         
         // Unwrap the 8-neighbors of p
         for (int i = 0; i < 8; i++) {
@@ -108,11 +115,11 @@ void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _m
             if (py < 0 || py >= h || px < 0 || px >= w || !pmask[py*w + px]) continue;
             
             // Get wrapped phase value at the p's neighbor
-            const double PDC = pphased[py*w + px];
+            const T PDC = pphased[py*w + px];
             
             // Unwrap p's neighbor
-            double D = (PDC - PDI)/(2*CV_PI);
-            pphasec[py*w + px] = PCI + 2*CV_PI*(D - cvRound(D));
+            T D = (PDC - PDI)/(2*static_cast<T>(CV_PI));
+            pphasec[py*w + px] = PCI + 2*static_cast<T>(CV_PI)*(D - cvRound(D));
             
             // Add the unwrapped point to the queue
             queue.emplace(px, py);
@@ -122,7 +129,422 @@ void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _m
         }
     }
     
-    _Phi.assign(phasec);
+    return phasec;
+}
+
+void spatialUnwrap(cv::InputArray _phased, const cv::Point p0, cv::InputArray _mask, cv::OutputArray _Phi) {
+    // Get input discontinuous phase map
+    cv::Mat phased = _phased.getMat();
+    if (p0.x < 0 or p0.x >= phased.cols or p0.y < 0 or p0.y >= phased.rows)
+        throw std::runtime_error("spatialUnwrap: invalid seed point (out of image bounds)");
+    
+    // Get an editable input mask (copy of the original mask)
+    cv::Mat mask;
+    _mask.copyTo(mask);
+    if (phased.size != mask.size)
+        throw std::runtime_error("spatialUnwrap: mask and discontinuous phase map must have the same size");
+    
+    if (phased.type() == CV_32FC1)
+        _Phi.assign(spatialUnwrap<float>(phased, p0, mask));
+    else if (phased.type() == CV_64FC1)
+        _Phi.assign(spatialUnwrap<double>(phased, p0, mask));
+    else
+        throw std::runtime_error("spatialUnwrap: discontinuous phase map must be a CV_32F or CV_64F single-channel array");
+}
+
+/* ---------------------------------------------------------------------------
+Scanline unwrapping. The mask is split in runs of consecutive pixels of each
+row, which are unwrapped from left to right in parallel row bands. The runs
+are then linked to their 8-connected runs of the previous row with a weighted
+union-find that stores the phase order offset of each run relative to its
+parent. Band borders are stitched the same way after the bands finish. Each
+pixel of the seed's region is written as phased + 2*pi*k with an integer
+order k, so rounding errors do not accumulate along the unwrapping paths.
+--------------------------------------------------------------------------- */
+
+// Run of consecutive mask pixels [x0, x1] of a row
+struct Run {
+    int x0, x1;
+    int parent; // union-find parent run
+    int offset; // phase order of the first pixel relative to the first pixel of the parent
+};
+
+// Phase order increment from the wrapped phase a to its neighbor b
+template <typename T>
+static inline int orderStep(T a, T b) {
+    T D = (b - a)/(2*static_cast<T>(CV_PI));
+    return -cvRound(D);
+}
+
+// Find the root of run r with path compression, and the order of r relative to the root
+static int findRoot(std::vector<Run>& runs, int r, int& offset) {
+    int root = r;
+    offset = 0;
+    while (runs[root].parent != root) {
+        offset += runs[root].offset;
+        root = runs[root].parent;
+    }
+    
+    for (int total = offset; r != root;) {
+        const int next = runs[r].parent, step = runs[r].offset;
+        runs[r].parent = root;
+        runs[r].offset = total;
+        total -= step;
+        r = next;
+    }
+    
+    return root;
+}
+
+// Merge the regions of runs a and b, where d is the order of b relative to a. When both runs
+// are already in the same region the existing link is kept, as in the flood fill
+static void linkRuns(std::vector<Run>& runs, int a, int b, int d) {
+    int oa, ob;
+    const int ra = findRoot(runs, a, oa), rb = findRoot(runs, b, ob);
+    if (ra == rb) return;
+    
+    runs[rb].parent = ra;
+    runs[rb].offset = d + oa - ob;
+}
+
+// Extract the runs of a row, appending them to `runs`, and the order of each pixel relative
+// to the first pixel of its run
+template <typename T>
+static void rowRuns(const T* phi, const uchar* mask, int* k, int w, std::vector<Run>& runs) {
+    for (int x = 0; x < w; x++) {
+        if (!mask[x]) continue;
+        
+        const int x0 = x;
+        k[x] = 0;
+        for (x++; x < w && mask[x]; x++)
+            k[x] = k[x-1] + orderStep(phi[x-1], phi[x]);
+        
+        const int idx = runs.size();
+        runs.push_back({x0, x-1, idx, 0});
+    }
+}
+
+// Link the runs [u0, u1) of a row with the 8-connected runs [l0, l1) of the next row
+template <typename T>
+static void linkRows(std::vector<Run>& runs, int u0, int u1, int l0, int l1,
+                     const T* phiu, const int* ku, const T* phil, const int* kl) {
+    int i = u0;
+    for (int j = l0; j < l1; j++) {
+        const int bx0 = runs[j].x0, bx1 = runs[j].x1;
+        
+        // Skip the upper runs that end before the neighborhood of the lower run
+        while (i < u1 && runs[i].x1 < bx0 - 1) i++;
+        
+        for (int t = i; t < u1 && runs[t].x0 <= bx1 + 1; t++) {
+            // Get a pair of neighbors: vertical when the runs overlap, else diagonal
+            int xu, xl;
+            if (runs[t].x1 < bx0) {
+                xu = runs[t].x1;
+                xl = bx0;
+            }
+            else if (bx1 < runs[t].x0) {
+                xu = runs[t].x0;
+                xl = bx1;
+            }
+            else
+                xu = xl = std::max(runs[t].x0, bx0);
+            
+            linkRuns(runs, t, j, ku[xu] + orderStep(phiu[xu], phil[xl]) - kl[xl]);
+        }
+    }
+}
+
+template <typename T>
+static void spatialUnwrapScanline(const cv::Mat& phased, const cv::Point p0, const cv::Mat& mask,
+                                  cv::OutputArray _Phi) {
+    const int h = phased.rows, w = phased.cols;
+    if (!mask.at<uchar>(p0.y, p0.x))
+        throw std::runtime_error("spatialUnwrapScanline: seed point isn't inside the mask");
+    
+    // Order of each pixel relative to the first pixel of its run
+    cv::Mat k(h, w, CV_32S);
+    
+    // Runs of each band, and index of the first run of each row (local to its band)
+    const int nbands = std::max(1, std::min(getNumThreads(), h/64));
+    std::vector<std::vector<Run>> band_runs(nbands);
+    std::vector<int> row_start(h + 1);
+    
+    // Extract and link the runs of each band
+    cv::parallel_for_(cv::Range(0, nbands), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; b++) {
+            std::vector<Run>& runs = band_runs[b];
+            const int r0 = b*h/nbands, r1 = (b + 1)*h/nbands;
+            
+            for (int y = r0; y < r1; y++) {
+                row_start[y] = runs.size();
+                rowRuns(phased.ptr<T>(y), mask.ptr<uchar>(y), k.ptr<int>(y), w, runs);
+                
+                if (y > r0)
+                    linkRows(runs, row_start[y-1], row_start[y], row_start[y], runs.size(),
+                             phased.ptr<T>(y-1), k.ptr<int>(y-1), phased.ptr<T>(y), k.ptr<int>(y));
+            }
+        }
+    }, nbands);
+    
+    // Gather the runs of all bands with global indices
+    std::vector<Run> runs;
+    for (int b = 0; b < nbands; b++) {
+        const int base = runs.size();
+        for (Run run : band_runs[b]) {
+            run.parent += base;
+            runs.push_back(run);
+        }
+        
+        for (int y = b*h/nbands; y < (b + 1)*h/nbands; y++)
+            row_start[y] += base;
+    }
+    row_start[h] = runs.size();
+    
+    // Stitch the bands at their borders
+    for (int b = 1; b < nbands; b++) {
+        const int y = b*h/nbands;
+        linkRows(runs, row_start[y-1], row_start[y], row_start[y], row_start[y+1],
+                 phased.ptr<T>(y-1), k.ptr<int>(y-1), phased.ptr<T>(y), k.ptr<int>(y));
+    }
+    
+    // Resolve the root and order of each run
+    for (int r = 0; r < static_cast<int>(runs.size()); r++) {
+        int offset;
+        runs[r].parent = findRoot(runs, r, offset);
+        runs[r].offset = offset;
+    }
+    
+    // Get the region and order of the seed point, which keeps its wrapped phase
+    int seed = row_start[p0.y];
+    while (runs[seed].x1 < p0.x) seed++;
+    const int root = runs[seed].parent;
+    const int k0 = runs[seed].offset + k.at<int>(p0.y, p0.x);
+    
+    // Write the unwrapped phase. Pixels outside the seed's region keep their wrapped phase
+    _Phi.create(h, w, phased.type());
+    cv::Mat Phi = _Phi.getMat();
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        constexpr T TWO_PI = 2*static_cast<T>(CV_PI);
+        
+        for (int y = r0; y < r1; y++) {
+            const T* pphased = phased.ptr<T>(y);
+            const int* pk = k.ptr<int>(y);
+            T* pPhi = Phi.ptr<T>(y);
+            
+            std::copy(pphased, pphased + w, pPhi);
+            for (int r = row_start[y]; r < row_start[y+1]; r++) {
+                if (runs[r].parent != root) continue;
+                
+                const int offset = runs[r].offset - k0;
+                for (int x = runs[r].x0; x <= runs[r].x1; x++)
+                    pPhi[x] = pphased[x] + TWO_PI*static_cast<T>(pk[x] + offset);
+            }
+        }
+    });
+}
+
+void spatialUnwrapScanline(cv::InputArray _phased, const cv::Point p0, cv::InputArray _mask, cv::OutputArray _Phi) {
+    // Get input discontinuous phase map and mask
+    cv::Mat phased = _phased.getMat(), mask = _mask.getMat();
+    if (p0.x < 0 or p0.x >= phased.cols or p0.y < 0 or p0.y >= phased.rows)
+        throw std::runtime_error("spatialUnwrapScanline: invalid seed point (out of image bounds)");
+    if (phased.size != mask.size)
+        throw std::runtime_error("spatialUnwrapScanline: mask and discontinuous phase map must have the same size");
+    if (mask.type() != CV_8UC1)
+        throw std::runtime_error("spatialUnwrapScanline: mask must be an 8-bit single-channel array");
+    
+    if (phased.type() == CV_32FC1)
+        spatialUnwrapScanline<float>(phased, p0, mask, _Phi);
+    else if (phased.type() == CV_64FC1)
+        spatialUnwrapScanline<double>(phased, p0, mask, _Phi);
+    else
+        throw std::runtime_error("spatialUnwrapScanline: discontinuous phase map must be a CV_32F or CV_64F single-channel array");
+}
+
+/* ---------------------------------------------------------------------------
+Quality-guided unwrapping. The quality values of the mask pixels are
+quantized in NUM_BUCKETS levels and the pixels waiting in the queue are
+stored in one bucket per level. The next pixel is popped from the highest
+non-empty bucket, which is found in amortized constant time instead of the
+log factor of a heap. As in the flood fill, each pixel is unwrapped with
+respect to the pixel that adds it to the queue, so the unwrapping grows
+through the most reliable pixels first and noisy pixels are reached last.
+--------------------------------------------------------------------------- */
+template <typename T>
+static cv::Mat qualityGuidedUnwrap(const cv::Mat& phased, const cv::Mat& quality, const cv::Point p0,
+                                   cv::Mat& mask) {
+    constexpr int NUM_BUCKETS = 1024;
+    
+    // Define offsets
+    constexpr int xo[8] = {-1, 0, 1,-1, 1,-1, 0, 1};
+    constexpr int yo[8] = {-1,-1,-1, 0, 0, 1, 1, 1};
+    
+    // Get the scale to quantize the quality values of the mask pixels
+    double qmin, qmax;
+    cv::minMaxLoc(quality, &qmin, &qmax, nullptr, nullptr, mask);
+    const double scale = qmax > qmin ? (NUM_BUCKETS - 1)/(qmax - qmin) : 0;
+    
+    // Initialize output continuous phase map
+    cv::Mat phasec = phased.clone();
+    
+    const T* pphased = phased.ptr<T>();
+    const float* pquality = quality.ptr<float>();
+    T* pphasec = phasec.ptr<T>();
+    uchar* pmask = mask.data;
+    
+    // Remove p0 from the mask and add it to the queue
+    const int h = phased.rows, w = phased.cols;
+    if (!pmask[p0.y*w + p0.x])
+        throw std::runtime_error("qualityGuidedUnwrap: seed point isn't inside the mask");
+    pmask[p0.y*w + p0.x] = 0;
+    
+    std::vector<std::vector<int>> buckets(NUM_BUCKETS);
+    buckets[NUM_BUCKETS-1].push_back(p0.y*w + p0.x);
+    int top = NUM_BUCKETS - 1; // highest bucket that can be non-empty
+    
+    while (true) {
+        // Get the current point from the highest non-empty bucket
+        while (top >= 0 && buckets[top].empty()) top--;
+        if (top < 0) break;
+        
+        const int idx = buckets[top].back();
+        buckets[top].pop_back();
+        const int x = idx%w, y = idx/w;
+        
+        // Get continuous and discontinuous phase values in p
+        const T PCI = pphasec[idx];
+        const T PDI = pphased[idx];
+        
+        // Unwrap the 8-neighbors of p
+        for (int i = 0; i < 8; i++) {
+            const int px = x + xo[i];
+            const int py = y + yo[i];
+            
+            // Check if point is outisde the mask or image bounds to ignore it
+            if (py < 0 || py >= h || px < 0 || px >= w || !pmask[py*w + px]) continue;
+            
+            // Get wrapped phase value at the p's neighbor
+            const T PDC = pphased[py*w + px];
+            
+            // Unwrap p's neighbor
+            T D = (PDC - PDI)/(2*static_cast<T>(CV_PI));
+            pphasec[py*w + px] = PCI + 2*static_cast<T>(CV_PI)*(D - cvRound(D));
+            
+            // Add the unwrapped point to the bucket of its quality level
+            const int b = std::clamp(cvRound((pquality[py*w + px] - qmin)*scale), 0, NUM_BUCKETS - 1);
+            buckets[b].push_back(py*w + px);
+            top = std::max(top, b);
+            
+            // Remove unwrapped point from the mask
+            pmask[py*w + px] = 0;
+        }
+    }
+    
+    return phasec;
+}
+
+void qualityGuidedUnwrap(cv::InputArray _phased, cv::InputArray _quality, const cv::Point p0, cv::InputArray _mask,
+                         cv::OutputArray _Phi) {
+    // Get input discontinuous phase map
+    cv::Mat phased = _phased.getMat();
+    if (p0.x < 0 or p0.x >= phased.cols or p0.y < 0 or p0.y >= phased.rows)
+        throw std::runtime_error("qualityGuidedUnwrap: invalid seed point (out of image bounds)");
+    
+    // Get an editable input mask (copy of the original mask)
+    cv::Mat mask;
+    _mask.copyTo(mask);
+    if (phased.size != mask.size)
+        throw std::runtime_error("qualityGuidedUnwrap: mask and discontinuous phase map must have the same size");
+    if (mask.type() != CV_8UC1)
+        throw std::runtime_error("qualityGuidedUnwrap: mask must be an 8-bit single-channel array");
+    
+    // Get the quality map in single precision
+    cv::Mat quality = _quality.getMat();
+    if (quality.size != phased.size or quality.channels() != 1)
+        throw std::runtime_error("qualityGuidedUnwrap: quality map must be a single-channel array of the phase map size");
+    if (quality.depth() != CV_32F)
+        quality.convertTo(quality, CV_32F);
+    
+    if (phased.type() == CV_32FC1)
+        _Phi.assign(qualityGuidedUnwrap<float>(phased, quality, p0, mask));
+    else if (phased.type() == CV_64FC1)
+        _Phi.assign(qualityGuidedUnwrap<double>(phased, quality, p0, mask));
+    else
+        throw std::runtime_error("qualityGuidedUnwrap: discontinuous phase map must be a CV_32F or CV_64F single-channel array");
+}
+
+// Wrapped forward differences of the phase map along x and y (backward differences at the last
+// column and row)
+template <typename T>
+static void wrappedGradients(const cv::Mat& phased, cv::Mat& dx, cv::Mat& dy) {
+    const int h = phased.rows, w = phased.cols;
+    constexpr T TWO_PI = 2*static_cast<T>(CV_PI);
+    
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        for (int y = r0; y < r1; y++) {
+            const int y1 = std::min(y + 1, h - 1);
+            const T* p = phased.ptr<T>(y);
+            const T* pprev = phased.ptr<T>(y1 - 1);
+            const T* pnext = phased.ptr<T>(y1);
+            T* pdx = dx.ptr<T>(y);
+            T* pdy = dy.ptr<T>(y);
+            
+            for (int x = 0; x < w; x++) {
+                const int x1 = std::min(x + 1, w - 1);
+                const T ddx = p[x1] - p[x1-1], ddy = pnext[x] - pprev[x];
+                pdx[x] = ddx - TWO_PI*cvRound(ddx/TWO_PI);
+                pdy[x] = ddy - TWO_PI*cvRound(ddy/TWO_PI);
+            }
+        }
+    });
+}
+
+template <typename T>
+static void phaseDerivativeVariance(const cv::Mat& phased, cv::OutputArray _pdv, int ksize) {
+    const int h = phased.rows, w = phased.cols;
+    
+    cv::Mat dx(h, w, phased.type()), dy(h, w, phased.type());
+    wrappedGradients<T>(phased, dx, dy);
+    
+    // Local means of the derivatives and of their squares
+    const cv::Size window(ksize, ksize);
+    cv::Mat mx, my, mxx, myy;
+    cv::boxFilter(dx, mx, -1, window, {-1, -1}, true, cv::BORDER_REPLICATE);
+    cv::boxFilter(dy, my, -1, window, {-1, -1}, true, cv::BORDER_REPLICATE);
+    cv::boxFilter(dx.mul(dx), mxx, -1, window, {-1, -1}, true, cv::BORDER_REPLICATE);
+    cv::boxFilter(dy.mul(dy), myy, -1, window, {-1, -1}, true, cv::BORDER_REPLICATE);
+    
+    _pdv.create(h, w, phased.type());
+    cv::Mat pdv = _pdv.getMat();
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        for (int y = r0; y < r1; y++) {
+            const T *pmx = mx.ptr<T>(y), *pmy = my.ptr<T>(y);
+            const T *pmxx = mxx.ptr<T>(y), *pmyy = myy.ptr<T>(y);
+            T* ppdv = pdv.ptr<T>(y);
+            
+            // sqrt(sum of squared deviations)/ksize^2 = sqrt(variance)/ksize
+            for (int x = 0; x < w; x++) {
+                const T vx = std::max(pmxx[x] - pmx[x]*pmx[x], T(0));
+                const T vy = std::max(pmyy[x] - pmy[x]*pmy[x], T(0));
+                ppdv[x] = (std::sqrt(vx) + std::sqrt(vy))/ksize;
+            }
+        }
+    });
+}
+
+void phaseDerivativeVariance(cv::InputArray _phased, cv::OutputArray _pdv, int ksize) {
+    cv::Mat phased = _phased.getMat();
+    if (phased.rows < 2 or phased.cols < 2)
+        throw std::runtime_error("phaseDerivativeVariance: phase map must be at least 2x2");
+    if (ksize < 1 or ksize%2 == 0)
+        throw std::runtime_error("phaseDerivativeVariance: ksize must be a positive odd number");
+    
+    if (phased.type() == CV_32FC1)
+        phaseDerivativeVariance<float>(phased, _pdv, ksize);
+    else if (phased.type() == CV_64FC1)
+        phaseDerivativeVariance<double>(phased, _pdv, ksize);
+    else
+        throw std::runtime_error("phaseDerivativeVariance: discontinuous phase map must be a CV_32F or CV_64F single-channel array");
 }
 
 } // namespace sl
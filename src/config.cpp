@@ -0,0 +1,44 @@
+#include <SLutils/config.hpp>
+
+#include <opencv2/core/utility.hpp> // cv::getNumThreads
+
+#include <atomic>
+
+
+namespace sl {
+
+// Number of threads requested by the user (<= 0 means OpenCV's default)
+static std::atomic<int> num_threads{0};
+
+// Accuracy mode of the phase kernels
+static std::atomic<PhaseAccuracy> phase_accuracy{PHASE_ACCURACY_EXACT};
+
+// Lookup tables of the three- and four-step kernels
+static std::atomic<bool> phase_lut{false};
+
+void setNumThreads(int nthreads) {
+    num_threads = nthreads;
+}
+
+int getNumThreads() {
+    int nthreads = num_threads;
+    return nthreads > 0 ? nthreads : cv::getNumThreads();
+}
+
+void setPhaseAccuracy(PhaseAccuracy accuracy) {
+    phase_accuracy = accuracy;
+}
+
+PhaseAccuracy getPhaseAccuracy() {
+    return phase_accuracy;
+}
+
+void setPhaseLUT(bool enable) {
+    phase_lut = enable;
+}
+
+bool getPhaseLUT() {
+    return phase_lut;
+}
+
+} // namespace sl
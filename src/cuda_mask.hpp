@@ -0,0 +1,32 @@
+#pragma once
+
+#include <opencv2/core/cuda.hpp>
+
+#include <stdexcept> // std::runtime_error
+#include <string>
+
+
+namespace sl::detail {
+
+// The CUDA versions compute all the pixels and only set the outputs outside the optional mask to 0.
+// Get the invalid pixels of a CV_8U mask of the given size, or an empty array when there is no mask
+inline cv::Mat invalidPixels(cv::InputArray _mask, cv::Size size, const char* func) {
+    if (_mask.empty())
+        return cv::Mat();
+    
+    cv::Mat mask = _mask.getMat();
+    if (mask.type() != CV_8UC1 or mask.size() != size)
+        throw std::runtime_error(std::string(func) + ": mask must be a CV_8U array of the same size as the images");
+    return mask == 0;
+}
+
+// Set the invalid pixels of a GPU output array to 0
+inline void clearInvalid(const cv::Mat& invalid, cv::OutputArray _dst) {
+    if (invalid.empty() or !_dst.needed())
+        return;
+    
+    cv::cuda::GpuMat dst = _dst.getGpuMat();
+    dst.setTo(cv::Scalar::all(0), cv::cuda::GpuMat(invalid));
+}
+
+} // namespace sl::detail
@@ -0,0 +1,154 @@
+#include "fast_math.hpp"
+
+#include <SLutils/config.hpp> // getPhaseAccuracy
+
+#include <algorithm> // std::min, std::max
+#include <cmath>
+
+
+/* ---------------------------------------------------------------------------
+The fast kernels are written as branch-free loops that the compiler vectorizes.
+With GCC on x86-64 Linux each kernel is compiled for AVX-512, AVX2 and the
+baseline ISA, and the best version for the running CPU is selected at load
+time. On AArch64 the baseline already includes NEON.
+--------------------------------------------------------------------------- */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define SLU_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define SLU_TARGET_CLONES
+#endif
+
+
+namespace sl::detail {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double PIO2 = 1.57079632679489661923;
+constexpr double PIO4 = 0.78539816339744830962;
+
+// Arc tangent of t in [-0.66, 0.66] with a rational approximation (Cephes)
+static inline double atanReduced(double t) {
+    const double z = t*t;
+    const double p = (((-8.750608600031904122785E-1*z - 1.615753718733365076637E1)*z
+                       - 7.500855792314704667340E1)*z - 1.228866684490136173410E2)*z - 6.485021904942025371773E1;
+    const double q = ((((z + 2.485846490142306297962E1)*z + 1.650270098316988542046E2)*z
+                       + 4.328810604912902668951E2)*z + 4.853903996359136964868E2)*z + 1.945506571482613964425E2;
+    return t + t*z*p/q;
+}
+
+static inline double fastAtan2(double y, double x) {
+    const double ax = std::abs(x), ay = std::abs(y);
+    
+    // Reduce to the first octant: t = min/max in [0, 1]
+    const double mx = std::max(ax, ay), mn = std::min(ax, ay);
+    const double t = mn/(mx > 0 ? mx : 1.0);
+    
+    // Reduce [0.66, 1] to [-0.2, 0] with atan(t) = pi/4 + atan((t - 1)/(t + 1))
+    const bool big = t > 0.66;
+    const double tr = (t - 1)/(t + 1);
+    double r = atanReduced(big ? tr : t) + (big ? PIO4 : 0.0);
+    
+    // Back to the full circle
+    r = ay > ax ? PIO2 - r : r;
+    // Sign bit of x rather than x < 0, so that atan2(+-0, -0) = +-pi as std::atan2. copysign
+    // vectorizes where std::signbit does not
+    r = std::copysign(1.0, x) < 0 ? PI - r : r;
+    return std::copysign(r, y);
+}
+
+// Single precision version of atanReduced for t in [-0.4142, 0.4142] (Cephes atanf)
+static inline float atanReduced(float t) {
+    const float z = t*t;
+    return (((8.05374449538e-2f*z - 1.38776856032e-1f)*z + 1.99777106478e-1f)*z - 3.33329491539e-1f)*z*t + t;
+}
+
+static inline float fastAtan2(float y, float x) {
+    const float ax = std::abs(x), ay = std::abs(y);
+    
+    const float mx = std::max(ax, ay), mn = std::min(ax, ay);
+    const float t = mn/(mx > 0 ? mx : 1.0f);
+    
+    // Reduce [tan(pi/8), 1] to [-0.4142, 0]
+    const bool big = t > 0.41421356f;
+    const float tr = (t - 1)/(t + 1);
+    float r = atanReduced(big ? tr : t) + (big ? static_cast<float>(PIO4) : 0.0f);
+    
+    r = ay > ax ? static_cast<float>(PIO2) - r : r;
+    r = std::copysign(1.0f, x) < 0 ? static_cast<float>(PI) - r : r;
+    return std::copysign(r, y);
+}
+
+SLU_TARGET_CLONES
+static void atan2Fast(const double* __restrict y, const double* __restrict x, double* __restrict dst, int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = fastAtan2(y[i], x[i]);
+}
+
+SLU_TARGET_CLONES
+static void rewrapFast(double* __restrict data, int n, double shift) {
+    constexpr double twoPI = 2*PI;
+    for (int i = 0; i < n; i++) {
+        const double v = data[i] + shift;
+        data[i] = v - twoPI*std::nearbyint(v/twoPI);
+    }
+}
+
+SLU_TARGET_CLONES
+static void atan2Fast(const float* __restrict y, const float* __restrict x, float* __restrict dst, int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = fastAtan2(y[i], x[i]);
+}
+
+SLU_TARGET_CLONES
+static void rewrapFast(float* __restrict data, int n, float shift) {
+    constexpr float twoPI = 2*PI;
+    for (int i = 0; i < n; i++) {
+        const float v = data[i] + shift;
+        data[i] = v - twoPI*std::nearbyint(v/twoPI);
+    }
+}
+
+void atan2(const double* y, const double* x, double* dst, int n) {
+    if (getPhaseAccuracy() == PHASE_ACCURACY_FAST) {
+        atan2Fast(y, x, dst, n);
+        return;
+    }
+    
+    for (int i = 0; i < n; i++)
+        dst[i] = std::atan2(y[i], x[i]);
+}
+
+void rewrap(double* data, int n, double shift) {
+    if (getPhaseAccuracy() == PHASE_ACCURACY_FAST) {
+        rewrapFast(data, n, shift);
+        return;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        const double v = data[i] + shift;
+        data[i] = std::atan2(std::sin(v), std::cos(v));
+    }
+}
+
+void atan2(const float* y, const float* x, float* dst, int n) {
+    if (getPhaseAccuracy() == PHASE_ACCURACY_FAST) {
+        atan2Fast(y, x, dst, n);
+        return;
+    }
+    
+    for (int i = 0; i < n; i++)
+        dst[i] = std::atan2(y[i], x[i]);
+}
+
+void rewrap(float* data, int n, float shift) {
+    if (getPhaseAccuracy() == PHASE_ACCURACY_FAST) {
+        rewrapFast(data, n, shift);
+        return;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        const float v = data[i] + shift;
+        data[i] = std::atan2(std::sin(v), std::cos(v));
+    }
+}
+
+} // namespace sl::detail
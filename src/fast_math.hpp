@@ -0,0 +1,15 @@
+#pragma once
+
+
+namespace sl::detail {
+
+// dst[i] = atan2(y[i], x[i]) for i in [0, n). dst must not alias y or x
+void atan2(const double* y, const double* x, double* dst, int n);
+void atan2(const float* y, const float* x, float* dst, int n);
+
+// Shift the wrapped phase values by `shift` and rewrap them to [-pi, pi] in place,
+// i.e. data[i] = atan2(sin(data[i] + shift), cos(data[i] + shift))
+void rewrap(double* data, int n, double shift);
+void rewrap(float* data, int n, float shift);
+
+} // namespace sl::detail
@@ -0,0 +1,227 @@
+#include <SLutils/frame_stack.hpp>
+
+#include <cstdint>
+#include <cstring> // std::memcpy, std::memcmp
+#include <fstream>
+#include <stdexcept> // std::runtime_error
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h> // ::open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // ::close
+#endif
+
+
+namespace sl {
+
+// Fixed part of the header of a frame-stack file
+struct FrameStackHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width, height, type, count;
+    std::uint64_t meta_size, data_offset;
+};
+
+static constexpr char FRAME_STACK_MAGIC[4] = {'S', 'L', 'F', 'S'};
+static constexpr std::uint32_t FRAME_STACK_VERSION = 1;
+static constexpr std::uint64_t FRAME_STACK_ALIGN = 64;
+
+// Frame types of a stack: single-channel arrays of any depth from CV_8U to CV_64F
+static bool isFrameStackType(int type) {
+    return type >= CV_8UC1 and type <= CV_64FC1;
+}
+
+void writeFrameStack(const std::string& path, cv::InputArrayOfArrays images, const std::string& metadata) {
+    std::vector<cv::Mat> frames;
+    if (images.kind() == cv::_InputArray::MAT and images.dims() != 3)
+        throw std::runtime_error("writeFrameStack: a single array input must be a 3D (n,h,w) array");
+    images.getMatVector(frames);
+    
+    if (frames.empty())
+        throw std::runtime_error("writeFrameStack: no frames to write");
+    for (const cv::Mat& frame : frames) {
+        if (frame.dims != 2 or !isFrameStackType(frame.type()) or frame.type() != frames[0].type() or frame.size() != frames[0].size())
+            throw std::runtime_error("writeFrameStack: all frames must be single-channel arrays of the same size and type");
+    }
+    
+    FrameStackHeader header{};
+    std::memcpy(header.magic, FRAME_STACK_MAGIC, sizeof(header.magic));
+    header.version = FRAME_STACK_VERSION;
+    header.width = frames[0].cols;
+    header.height = frames[0].rows;
+    header.type = frames[0].type();
+    header.count = static_cast<std::int32_t>(frames.size());
+    header.meta_size = metadata.size();
+    header.data_offset = (sizeof(header) + metadata.size() + FRAME_STACK_ALIGN - 1)/FRAME_STACK_ALIGN*FRAME_STACK_ALIGN;
+    
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("writeFrameStack: unable to open '" + path + "' for writing");
+    
+    const std::vector<char> padding(header.data_offset - sizeof(header) - metadata.size(), 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(metadata.data(), metadata.size());
+    file.write(padding.data(), padding.size());
+    
+    const std::size_t row_size = frames[0].cols*frames[0].elemSize();
+    for (const cv::Mat& frame : frames) {
+        if (frame.isContinuous())
+            file.write(frame.ptr<char>(), frame.rows*row_size);
+        else {
+            for (int i = 0; i < frame.rows; i++)
+                file.write(frame.ptr<char>(i), row_size);
+        }
+    }
+    
+    if (!file)
+        throw std::runtime_error("writeFrameStack: error writing '" + path + "'");
+}
+
+FrameStack::FrameStack(FrameStack&& other) noexcept {
+    *this = std::move(other);
+}
+
+FrameStack& FrameStack::operator=(FrameStack&& other) noexcept {
+    if (this != &other) {
+        close();
+        base = other.base;
+        map_size = other.map_size;
+        data = other.data;
+        frame_bytes = other.frame_bytes;
+        n_frames = other.n_frames;
+        frame_type = other.frame_type;
+        frame_size = other.frame_size;
+        meta = std::move(other.meta);
+        
+        other.base = nullptr;
+        other.map_size = 0;
+        other.data = nullptr;
+        other.n_frames = 0;
+    }
+    
+    return *this;
+}
+
+/* ---------------------------------------------------------------------------
+Map the whole file read-only. The pages are loaded by the OS on first access,
+so opening a stack that is in the page cache does not copy any pixel data.
+--------------------------------------------------------------------------- */
+void FrameStack::open(const std::string& path) {
+    close();
+    
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("FrameStack::open: unable to open '" + path + "'");
+    
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    map_size = static_cast<std::size_t>(file_size.QuadPart);
+    
+    HANDLE mapping = map_size ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (mapping) {
+        base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("FrameStack::open: unable to open '" + path + "'");
+    
+    struct stat st;
+    map_size = fstat(fd, &st) == 0 ? static_cast<std::size_t>(st.st_size) : 0;
+    
+    if (map_size) {
+        base = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+            base = nullptr;
+    }
+    ::close(fd);
+#endif
+    
+    if (!base) {
+        map_size = 0;
+        throw std::runtime_error("FrameStack::open: unable to map '" + path + "'");
+    }
+    
+    // Validate the header before exposing any frame
+    const unsigned char* bytes = static_cast<const unsigned char*>(base);
+    FrameStackHeader header;
+    if (map_size < sizeof(header)) {
+        close();
+        throw std::runtime_error("FrameStack::open: '" + path + "' is not a frame-stack file");
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    
+    if (std::memcmp(header.magic, FRAME_STACK_MAGIC, sizeof(header.magic)) != 0 or header.version != FRAME_STACK_VERSION) {
+        close();
+        throw std::runtime_error("FrameStack::open: '" + path + "' is not a frame-stack file");
+    }
+    
+    // The sizes are checked by division, so that a crafted header cannot overflow them
+    bool valid = header.width > 0 and header.height > 0 and header.count > 0 and isFrameStackType(header.type)
+        and header.meta_size <= map_size and header.data_offset % FRAME_STACK_ALIGN == 0
+        and header.data_offset >= sizeof(header) + header.meta_size and header.data_offset <= map_size;
+    if (valid) {
+        const std::uint64_t available = map_size - header.data_offset;
+        const std::uint64_t row_bytes = static_cast<std::uint64_t>(header.width)*CV_ELEM_SIZE(header.type);
+        valid = static_cast<std::uint64_t>(header.height) <= available/row_bytes
+            and static_cast<std::uint64_t>(header.count) <= available/(row_bytes*header.height);
+    }
+    if (!valid) {
+        close();
+        throw std::runtime_error("FrameStack::open: invalid or truncated header in '" + path + "'");
+    }
+    
+    frame_bytes = static_cast<std::size_t>(header.width)*header.height*CV_ELEM_SIZE(header.type);
+    data = bytes + header.data_offset;
+    n_frames = header.count;
+    frame_type = header.type;
+    frame_size = cv::Size(header.width, header.height);
+    meta.assign(reinterpret_cast<const char*>(bytes + sizeof(header)), header.meta_size);
+}
+
+void FrameStack::close() {
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap(base, map_size);
+#endif
+    }
+    
+    base = nullptr;
+    map_size = 0;
+    data = nullptr;
+    frame_bytes = 0;
+    n_frames = 0;
+    frame_type = 0;
+    frame_size = cv::Size();
+    meta.clear();
+}
+
+cv::Mat FrameStack::frames(int first, int count) const {
+    if (first < 0 or count <= 0 or first > n_frames - count)
+        throw std::runtime_error("FrameStack::frames: invalid frame range");
+    
+    const int sizes[3] = {count, frame_size.height, frame_size.width};
+    
+    // The mapping is read-only: the arrays must only be used as inputs
+    return cv::Mat(3, sizes, frame_type, const_cast<unsigned char*>(data + first*frame_bytes));
+}
+
+cv::Mat FrameStack::frame(int i) const {
+    if (i < 0 or i >= n_frames)
+        throw std::runtime_error("FrameStack::frame: invalid frame index");
+    
+    return cv::Mat(frame_size, frame_type, const_cast<unsigned char*>(data + i*frame_bytes));
+}
+
+} // namespace sl
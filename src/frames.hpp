@@ -0,0 +1,172 @@
+#pragma once
+
+#include <SLutils/config.hpp> // getNumThreads
+
+#include "stats.hpp" // StageTimer
+
+#include <opencv2/core/mat.hpp>
+#include <opencv2/core/utility.hpp> // cv::parallel_for_
+#include <opencv2/imgcodecs.hpp> // cv::imread
+
+#include <algorithm> // std::min, std::max
+#include <deque>
+#include <future> // std::async
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <utility> // std::pair
+#include <vector>
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Read a list of images from disk as 8-bit grayscale frames, for the kernels
+that need all the frames at once (the others accumulate the frames from a
+FrameLoader as they are decoded). The images are decoded concurrently on the
+OpenCV thread pool (at most sl::getNumThreads() at a time), so the decoding
+time of a scan is about that of its slowest image instead of the sum. All the
+images must have the same size, which is checked here, before any
+computation starts.
+--------------------------------------------------------------------------- */
+inline std::vector<cv::Mat> readImages(const std::vector<std::string>& impaths) {
+    const int n = static_cast<int>(impaths.size());
+    if (n == 0)
+        throw std::runtime_error("readImages: no image paths");
+    
+    std::vector<cv::Mat> images(n);
+    StageTimer timer(STATS_IMREAD, 0);
+    
+    auto decode = [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; i++) {
+            // An empty image is reported below, together with the unreadable files
+            try {
+                images[i] = cv::imread(impaths[i], 0);
+            }
+            catch (const cv::Exception&) {
+                images[i].release();
+            }
+        }
+    };
+    
+    const int nstripes = std::min(getNumThreads(), n);
+    if (nstripes <= 1)
+        decode(cv::Range(0, n));
+    else
+        cv::parallel_for_(cv::Range(0, n), decode, nstripes);
+    
+    for (int i = 0; i < n; i++) {
+        if (images[i].empty())
+            throw std::runtime_error("readImages: unable to read image '" + impaths[i] + "'");
+        if (images[i].size() != images[0].size())
+            throw std::runtime_error("readImages: image '" + impaths[i] + "' has a different size than '" + impaths[0] + "'");
+    }
+    timer.setBytes(static_cast<std::uint64_t>(n)*images[0].total());
+    
+    return images;
+}
+
+// Read two lists of images that are used together (e.g. phase-shifting and graycode patterns),
+// decoding all of them concurrently and checking that they have the same size
+inline std::pair<std::vector<cv::Mat>, std::vector<cv::Mat>> readImages(const std::vector<std::string>& impaths1,
+                                                                        const std::vector<std::string>& impaths2) {
+    std::vector<std::string> impaths(impaths1);
+    impaths.insert(impaths.end(), impaths2.begin(), impaths2.end());
+    
+    std::vector<cv::Mat> images = readImages(impaths);
+    return {std::vector<cv::Mat>(images.begin(), images.begin() + impaths1.size()),
+            std::vector<cv::Mat>(images.begin() + impaths1.size(), images.end())};
+}
+
+/* ---------------------------------------------------------------------------
+Decode a list of images in order while the caller consumes them. Up to window
+images after the one being consumed are decoded concurrently, each on its own
+thread, so the caller accumulates frame k while frames k+1..k+window decode,
+and only those frames are held in memory. next() checks that each image is
+readable and has the size of the first one. The STATS_IMREAD stage records
+the time the caller waits for the decoding, which is not hidden by the
+accumulation.
+--------------------------------------------------------------------------- */
+class FrameLoader {
+public:
+    explicit FrameLoader(const std::vector<std::string>& impaths, int window = getNumThreads())
+        : impaths(impaths), window(std::max(1, window)) {
+        if (impaths.empty())
+            throw std::runtime_error("readImages: no image paths");
+        
+        for (int i = 0; i < std::min(this->window, size()); i++)
+            launch(i);
+    }
+    
+    int size() const { return static_cast<int>(impaths.size()); }
+    
+    // Next decoded image, in the order of the paths
+    cv::Mat next() {
+        StageTimer timer(STATS_IMREAD, 0);
+        const int i = consumed++;
+        cv::Mat image = pending.front().get();
+        pending.pop_front();
+        if (i + window < size())
+            launch(i + window);
+        
+        if (image.empty())
+            throw std::runtime_error("readImages: unable to read image '" + impaths[i] + "'");
+        if (i == 0)
+            image_size = image.size();
+        else if (image.size() != image_size)
+            throw std::runtime_error("readImages: image '" + impaths[i] + "' has a different size than '" + impaths[0] + "'");
+        timer.setBytes(image.total());
+        
+        return image;
+    }
+
+private:
+    void launch(int i) {
+        pending.push_back(std::async(std::launch::async, [&path = impaths[i]]() {
+            // An empty image is reported by next, together with the unreadable files
+            try {
+                return cv::imread(path, 0);
+            }
+            catch (const cv::Exception&) {
+                return cv::Mat();
+            }
+        }));
+    }
+    
+    const std::vector<std::string>& impaths;
+    int window, consumed = 0;
+    cv::Size image_size;
+    std::deque<std::future<cv::Mat>> pending; // the destructor waits for the images still decoding
+};
+
+// Push the next count images of loader to an accumulator, with the indices 0 to count - 1
+template <typename Accumulator>
+void pushImages(FrameLoader& loader, Accumulator& acc, int count) {
+    for (int i = 0; i < count; i++)
+        acc.push(loader.next(), i);
+}
+
+/* ---------------------------------------------------------------------------
+Get 2D headers to each frame of an input stack without copying pixel data.
+The stack can be a std::vector<cv::Mat> or a contiguous (n,h,w) 3D array,
+e.g. the one returned by graycodeword. All frames must be single-channel,
+8-bit and of the same size.
+--------------------------------------------------------------------------- */
+inline void getFrames(cv::InputArrayOfArrays images, std::vector<cv::Mat>& frames, const char* func) {
+    if (images.kind() == cv::_InputArray::MAT and images.dims() != 3)
+        throw std::runtime_error(std::string(func) + ": a single array input must be a 3D (n,h,w) array");
+
+    images.getMatVector(frames);
+
+    for (const cv::Mat& frame : frames) {
+        if (frame.dims != 2 or frame.type() != CV_8UC1 or frame.size() != frames[0].size())
+            throw std::runtime_error(std::string(func) + ": all images must be 8-bit single-channel arrays of the same size");
+    }
+}
+
+// Check the requested depth of a floating-point output array
+inline void checkFloatDepth(int dtype, const char* func) {
+    if (dtype != CV_32F and dtype != CV_64F)
+        throw std::runtime_error(std::string(func) + ": dtype must be CV_32F or CV_64F");
+}
+
+} // namespace sl::detail
@@ -1,146 +1,584 @@
 #include <SLutils/fringe_analysis.hpp>
+#include <SLutils/streaming.hpp> // PhaseShiftAccumulator
 
+#include "buffers.hpp" // getBuffer, getFrameList
+#include "fast_math.hpp" // detail::atan2
+#include "frames.hpp" // getFrames, readImages, FrameLoader, checkFloatDepth
+#include "parallel.hpp" // parallelForRows
+#include "phase_lut.hpp" // threeStepLUT, fourStepLUT
+#include "phase_shifting.hpp"
+#include "stats.hpp" // StageTimer
+#include "tile_mask.hpp"
+
+#include <SLutils/config.hpp> // getPhaseLUT
+
+#include <opencv2/core/utility.hpp> // cv::AutoBuffer
+
+#include <algorithm> // std::min, std::max, std::copy
 #include <cmath> // std::atan2, std::sqrt
+#include <cstring> // std::memset
 #include <stdexcept> // std::runtime_error
+#include <string>
 
 
 namespace sl {
 
-void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int N) {
-    if (impaths.size() < 3)
-        throw std::runtime_error("NStepPhaseShifting needs at least 3 fringe patterns");
+// Number of pixels of a row processed at once by nStepRow. It is chosen so that the
+// sin/cos/intensity accumulators of a block stay in the L1 cache
+constexpr int BLOCK_SIZE = 512;
 
-    // Initialize sumIsin and sumIcos with the first fringe image
-    cv::Mat I = cv::imread(impaths[0], 0);
-    I.convertTo(I, CV_64F); // convert image from uint8 to floating point
-    double delta = 2*CV_PI/N; // delta for i = 0
-    cv::Mat sumIsin = I*std::sin(delta);
-    cv::Mat sumIcos = I*std::cos(delta);
-    
-    // Add the other fringes to sumIsin and sumIcos
-    for (std::size_t i = 1; i < impaths.size(); i++) {
-        cv::Mat I = cv::imread(impaths[i], 0);
-        I.convertTo(I, CV_64F);
-        double delta = 2*CV_PI*(i + 1)/N;
-        sumIsin += I*std::sin(delta);
-        sumIcos += I*std::cos(delta);
+template <typename T>
+static void nStepRow(const uchar* const* rows, int n, const T* sn, const T* cs, int width,
+                     T* phase, T* data_modulation, uchar* valid, const uchar* mask,
+                     const detail::ValidityPass* validity) {
+    T sumIsin[BLOCK_SIZE], sumIcos[BLOCK_SIZE], sumI[BLOCK_SIZE];
+    
+    for (int j0 = 0; j0 < width; j0 += BLOCK_SIZE) {
+        const int len = std::min(BLOCK_SIZE, width - j0);
+        
+        // Initialize sumI, sumIsin, and sumIcos with the first fringe image
+        const uchar* I = rows[0] + j0;
+        for (int j = 0; j < len; j++) {
+            sumIsin[j] = I[j]*sn[0];
+            sumIcos[j] = I[j]*cs[0];
+            sumI[j] = I[j];
+        }
+        
+        // Add the other fringes to sumI, sumIsin, and sumIcos
+        for (int k = 1; k < n; k++) {
+            const uchar* I = rows[k] + j0;
+            const T s = sn[k], c = cs[k];
+            for (int j = 0; j < len; j++) {
+                sumIsin[j] += I[j]*s;
+                sumIcos[j] += I[j]*c;
+                sumI[j] += I[j];
+            }
+        }
+        
+        // Estimate data modulation: sqrt(sumIcos^2 + sumIsin^2)/sumI
+        if (data_modulation) {
+            for (int j = 0; j < len; j++)
+                data_modulation[j0 + j] = std::sqrt(sumIcos[j]*sumIcos[j] + sumIsin[j]*sumIsin[j])/sumI[j];
+        }
+        
+        // Validity: no saturated intensity, sumI > 0 and sumIcos^2 + sumIsin^2 >= (min_modulation*sumI)^2,
+        // which is the data modulation test without the square root and the division
+        if (valid) {
+            uchar maxI[BLOCK_SIZE];
+            std::copy(rows[0] + j0, rows[0] + j0 + len, maxI);
+            for (int k = 1; k < n; k++) {
+                const uchar* I = rows[k] + j0;
+                for (int j = 0; j < len; j++)
+                    maxI[j] = std::max(maxI[j], I[j]);
+            }
+            
+            const T t = static_cast<T>(validity->min_modulation);
+            for (int j = 0; j < len; j++) {
+                const T m = t*sumI[j];
+                const bool ok = maxI[j] < validity->saturation and sumI[j] > 0 and
+                                sumIcos[j]*sumIcos[j] + sumIsin[j]*sumIsin[j] >= m*m;
+                valid[j0 + j] = ok and (!mask or mask[j0 + j]) ? 255 : 0;
+            }
+        }
+        
+        // Estimate final wrapped phase as -atan2(sumIsin, sumIcos) = atan2(-sumIsin, sumIcos)
+        for (int j = 0; j < len; j++)
+            sumIsin[j] = -sumIsin[j];
+        detail::atan2(sumIsin, sumIcos, phase + j0, len);
     }
+}
+
+/* ---------------------------------------------------------------------------
+Weights of the N-step algorithm for the common step counts. The sine and
+cosine of each phase shift delta_k = 2*pi*(k + 1)/N are written as
+2*sin(delta_k) = ps[k] + qs[k]*R and 2*cos(delta_k) = pc[k] + qc[k]*R, with
+integer weights and a single irrational constant R, so that the sums of the
+algorithm are accumulated exactly in integers and R is applied once per pixel.
+--------------------------------------------------------------------------- */
+template <int N> struct StepWeights;
+
+template <> struct StepWeights<3> {
+    static constexpr double R = 1.7320508075688772935; // sqrt(3)
+    static constexpr int ps[3] = {0, 0, 0}, qs[3] = {1, -1, 0};
+    static constexpr int pc[3] = {-1, -1, 2}, qc[3] = {0, 0, 0};
+};
+
+template <> struct StepWeights<4> {
+    static constexpr double R = 0;
+    static constexpr int ps[4] = {2, 0, -2, 0}, qs[4] = {0, 0, 0, 0};
+    static constexpr int pc[4] = {0, -2, 0, 2}, qc[4] = {0, 0, 0, 0};
+};
+
+template <> struct StepWeights<6> {
+    static constexpr double R = 1.7320508075688772935; // sqrt(3)
+    static constexpr int ps[6] = {0, 0, 0, 0, 0, 0}, qs[6] = {1, 1, 0, -1, -1, 0};
+    static constexpr int pc[6] = {1, -1, -2, -1, 1, 2}, qc[6] = {0, 0, 0, 0, 0, 0};
+};
+
+template <> struct StepWeights<8> {
+    static constexpr double R = 1.4142135623730950488; // sqrt(2)
+    static constexpr int ps[8] = {0, 2, 0, 0, 0, -2, 0, 0}, qs[8] = {1, 0, 1, 0, -1, 0, -1, 0};
+    static constexpr int pc[8] = {0, 0, 0, -2, 0, 0, 0, 2}, qc[8] = {1, 0, -1, 0, -1, 0, 1, 0};
+};
+
+// Same as nStepRow for n == N frames with the weights of StepWeights<N>. N is a compile-time constant,
+// so the loop over the frames is unrolled, the zero weights vanish, and the integer sums of the frames
+// only cost a few additions per pixel (e.g. atan2(I3 - I1, I4 - I2) for N = 4)
+template <typename T, int N>
+static void nStepRowFixed(const uchar* const* rows, int, const T*, const T*, int width,
+                          T* phase, T* data_modulation, uchar* valid, const uchar* mask,
+                          const detail::ValidityPass* validity) {
+    using W = StepWeights<N>;
+    constexpr T R = static_cast<T>(W::R);
+    T num[BLOCK_SIZE], den[BLOCK_SIZE];
+    int sumI[BLOCK_SIZE];
     
-    // Set output wrapped phase array
-    _phase.create(sumIsin.size(), sumIsin.type());
-    cv::Mat phase = _phase.getMat();
+    for (int j0 = 0; j0 < width; j0 += BLOCK_SIZE) {
+        const int len = std::min(BLOCK_SIZE, width - j0);
+        
+        // num = -2*sumIsin and den = 2*sumIcos, from the integer sums of the fringe images
+        for (int j = 0; j < len; j++) {
+            int sp = 0, sq = 0, cp = 0, cq = 0, s = 0;
+            for (int k = 0; k < N; k++) {
+                const int I = rows[k][j0 + j];
+                sp += W::ps[k]*I;
+                sq += W::qs[k]*I;
+                cp += W::pc[k]*I;
+                cq += W::qc[k]*I;
+                s += I;
+            }
+            num[j] = -(static_cast<T>(sp) + R*static_cast<T>(sq));
+            den[j] = static_cast<T>(cp) + R*static_cast<T>(cq);
+            sumI[j] = s;
+        }
+        
+        // Estimate data modulation: sqrt(sumIcos^2 + sumIsin^2)/sumI
+        if (data_modulation) {
+            for (int j = 0; j < len; j++)
+                data_modulation[j0 + j] = std::sqrt(num[j]*num[j] + den[j]*den[j])/(2*static_cast<T>(sumI[j]));
+        }
+        
+        // Validity, as in nStepRow
+        if (valid) {
+            const T t = static_cast<T>(2*validity->min_modulation);
+            for (int j = 0; j < len; j++) {
+                int maxI = rows[0][j0 + j];
+                for (int k = 1; k < N; k++)
+                    maxI = std::max(maxI, int(rows[k][j0 + j]));
+                
+                const T m = t*sumI[j];
+                const bool ok = maxI < validity->saturation and sumI[j] > 0 and num[j]*num[j] + den[j]*den[j] >= m*m;
+                valid[j0 + j] = ok and (!mask or mask[j0 + j]) ? 255 : 0;
+            }
+        }
+        
+        // Estimate final wrapped phase
+        detail::atan2(num, den, phase + j0, len);
+    }
+}
+
+// Allocate the arrays of the validity pass, if any
+static void createValidity(detail::ValidityPass* validity, int h, int w) {
+    if (validity) {
+        validity->valid.create(h, w, CV_8U);
+        validity->extents.create(h, detail::rowTiles(w), CV_32SC2);
+    }
+}
+
+// Row i of the validity mask, or null without validity pass. The pixels outside the runs of the
+// mask are not computed and are invalid
+static uchar* beginValidRow(detail::ValidityPass* validity, const detail::TileMask& tiles, int i) {
+    if (!validity)
+        return nullptr;
     
-    // Estimate final wrapped phase with atan2
-    double* pphase = phase.ptr<double>();
-    double* psumIsin = sumIsin.ptr<double>();
-    double* psumIcos = sumIcos.ptr<double>();
-    for (std::size_t i = 0; i < sumIsin.total(); i++)
-        pphase[i] = -std::atan2(psumIsin[i], psumIcos[i]);
+    uchar* pvalid = validity->valid.ptr<uchar>(i);
+    if (tiles.hasMask())
+        std::memset(pvalid, 0, validity->valid.cols);
+    return pvalid;
 }
 
-void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
-                                   cv::OutputArray _data_modulation, int N) {
-    if (impaths.size() < 3)
-        throw std::runtime_error("NStepPhaseShifting_modulation needs at least 3 fringe patterns");
+// Record the column extents of the valid pixels of row i, while the row is still in cache
+static void endValidRow(detail::ValidityPass* validity, int i) {
+    if (validity)
+        detail::maskRowExtents(validity->valid.ptr<uchar>(i), validity->valid.cols, validity->extents.ptr<cv::Vec2i>(i));
+}
+
+/* ---------------------------------------------------------------------------
+Phase-shifting with a lookup table for 8-bit images. For each pixel, numden
+gives the integer numerator a and denominator b of the algorithm, and the
+wrapped phase and the magnitude sqrt(num^2 + den^2) are read from the table
+instead of being computed. The data modulation is scale*magnitude/sumI.
+--------------------------------------------------------------------------- */
+template <typename T, typename NumDen>
+static void lutPhaseShifting(const cv::Mat* frames, int n, const detail::PhaseLUT<T>& lut, T scale,
+                             NumDen numden, cv::OutputArray _phase, cv::OutputArray _data_modulation,
+                             const detail::TileMask& tiles, detail::ValidityPass* validity) {
+    const int h = frames[0].rows, w = frames[0].cols;
+    constexpr int depth = cv::traits::Depth<T>::value;
+    
+    // Set output arrays
+    _phase.create(h, w, depth);
+    cv::Mat phase = _phase.getMat();
+    
+    cv::Mat data_modulation;
+    if (_data_modulation.needed()) {
+        _data_modulation.create(h, w, depth);
+        data_modulation = _data_modulation.getMat();
+    }
+    
+    createValidity(validity, h, w);
     
-    // Initialize sumI, sumIsin, and sumIcos using the first fringe image
-    cv::Mat sumI = cv::imread(impaths[0], 0); // In this case sumI = I_0
-    sumI.convertTo(sumI, CV_64F); // convert image from uint8 to floating point
-    double delta = 2*CV_PI/N; // delta for i = 0
+    const T* lut_phase = lut.phase.data();
+    const T* lut_magnitude = lut.magnitude.data();
+    const T min_modulation = validity ? static_cast<T>(validity->min_modulation) : T(0);
     
-    cv::Mat sumIsin = sumI*std::sin(delta);
-    cv::Mat sumIcos = sumI*std::cos(delta);
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        const uchar* rows[4];
+        for (int i = r0; i < r1; i++) {
+            for (int k = 0; k < n; k++)
+                rows[k] = frames[k].ptr<uchar>(i);
+            
+            T* pphase = phase.ptr<T>(i);
+            T* gamma = data_modulation.empty() ? nullptr : data_modulation.ptr<T>(i);
+            uchar* pvalid = beginValidRow(validity, tiles, i);
+            const uchar* pmask = tiles.maskRow(i);
+            tiles.forEachRun(i, [&](int j0, int j1) {
+                for (int j = j0; j < j1; j++) {
+                    int a, b;
+                    numden(rows, j, a, b);
+                    const int idx = lut.index(a, b);
+                    pphase[j] = lut_phase[idx];
+                    
+                    if (gamma or pvalid) {
+                        int sumI = 0, maxI = 0;
+                        for (int k = 0; k < n; k++) {
+                            sumI += rows[k][j];
+                            maxI = std::max(maxI, int(rows[k][j]));
+                        }
+                        if (gamma)
+                            gamma[j] = scale*lut_magnitude[idx]/static_cast<T>(sumI);
+                        if (pvalid) {
+                            const bool ok = maxI < validity->saturation and sumI > 0 and
+                                            scale*lut_magnitude[idx] >= min_modulation*sumI;
+                            pvalid[j] = ok and (!pmask or pmask[j]) ? 255 : 0;
+                        }
+                    }
+                }
+            });
+            endValidRow(validity, i);
+        }
+    });
+}
+
+/* ---------------------------------------------------------------------------
+Fused N-step phase-shifting. The fringe images are read row by row and block by
+block, and the wrapped phase (and optionally the data modulation) is written in
+the same sweep, without any full-size intermediate array. T is the precision of
+the accumulators and of the output arrays. Only the runs of occupied tiles of
+the mask are read and computed. Unless the lookup tables are enabled, the rows
+of 3, 4, 6 and 8 steps are computed by the integer kernels of nStepRowFixed.
+--------------------------------------------------------------------------- */
+template <typename T>
+static void nStepPhaseShifting(const cv::Mat* frames, int n, int N, cv::OutputArray _phase,
+                               cv::OutputArray _data_modulation, const detail::TileMask& tiles,
+                               detail::ValidityPass* validity) {
+    const int h = frames[0].rows, w = frames[0].cols;
+    constexpr int depth = cv::traits::Depth<T>::value;
     
+    // Table lookup for the three- and four-step cases:
+    // N = 3: phase = atan2(sqrt(3)*(I2 - I1), 2*I3 - I1 - I2), whose terms are twice sumIsin and sumIcos
+    // N = 4: phase = atan2(I3 - I1, I4 - I2)
+    if (getPhaseLUT() and n == N and N == 3) {
+        lutPhaseShifting<T>(frames, 3, detail::threeStepLUT<T>(), T(0.5), [](const uchar* const* I, int j, int& a, int& b) {
+            a = I[1][j] - I[0][j];
+            b = 2*I[2][j] - I[0][j] - I[1][j];
+        }, _phase, _data_modulation, tiles, validity);
+        return;
+    }
+    if (getPhaseLUT() and n == N and N == 4) {
+        lutPhaseShifting<T>(frames, 4, detail::fourStepLUT<T>(), T(1), [](const uchar* const* I, int j, int& a, int& b) {
+            a = I[2][j] - I[0][j];
+            b = I[3][j] - I[1][j];
+        }, _phase, _data_modulation, tiles, validity);
+        return;
+    }
     
-    // Add the other fringes to sumI, sumIsin, and sumIcos
-    for (std::size_t i = 1; i < impaths.size(); i++) {
-        cv::Mat I = cv::imread(impaths[i], 0);
-        I.convertTo(I, CV_64F);
+    // Sine and cosine of the phase shift of each fringe image: delta_i = 2*pi*(i + 1)/N
+    cv::AutoBuffer<T> sn(n), cs(n);
+    for (int i = 0; i < n; i++) {
         double delta = 2*CV_PI*(i + 1)/N;
-        
-        sumI += I;
-        sumIsin += I*std::sin(delta);
-        sumIcos += I*std::cos(delta);
+        sn[i] = static_cast<T>(std::sin(delta));
+        cs[i] = static_cast<T>(std::cos(delta));
     }
     
-    // ------------- Estimate final wrapped phase with atan2
-    _phase.create(sumIsin.size(), sumIsin.type());
+    // Set output arrays
+    _phase.create(h, w, depth);
     cv::Mat phase = _phase.getMat();
-    double* pphase = phase.ptr<double>();
-    double* psumIsin = sumIsin.ptr<double>();
-    double* psumIcos = sumIcos.ptr<double>();
-    for (std::size_t i = 0; i < sumIsin.total(); i++)
-        pphase[i] = -std::atan2(psumIsin[i], psumIcos[i]);
     
-    // ----------- Estimate data modulation: sqrt(sumIcos^2 + sumIsin^2)/sumI
-    cv::Mat numerator = sumIcos.mul(sumIcos) + sumIsin.mul(sumIsin);
-    cv::sqrt(numerator, numerator);
-    cv::Mat data_modulation = numerator/sumI;
-    _data_modulation.assign(data_modulation);
+    cv::Mat data_modulation;
+    if (_data_modulation.needed()) {
+        _data_modulation.create(h, w, depth);
+        data_modulation = _data_modulation.getMat();
+    }
+    
+    createValidity(validity, h, w);
+    
+    // Specialized kernels with integer weights for the common step counts, generic kernel otherwise
+    auto row_kernel = nStepRow<T>;
+    if (n == N) {
+        switch (N) {
+            case 3: row_kernel = nStepRowFixed<T, 3>; break;
+            case 4: row_kernel = nStepRowFixed<T, 4>; break;
+            case 6: row_kernel = nStepRowFixed<T, 6>; break;
+            case 8: row_kernel = nStepRowFixed<T, 8>; break;
+        }
+    }
+    
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        cv::AutoBuffer<const uchar*> rows(n);
+        for (int i = r0; i < r1; i++) {
+            T* pphase = phase.ptr<T>(i);
+            T* gamma = data_modulation.empty() ? nullptr : data_modulation.ptr<T>(i);
+            uchar* pvalid = beginValidRow(validity, tiles, i);
+            const uchar* pmask = tiles.maskRow(i);
+            tiles.forEachRun(i, [&](int j0, int j1) {
+                for (int k = 0; k < n; k++)
+                    rows[k] = frames[k].ptr<uchar>(i) + j0;
+                
+                row_kernel(rows.data(), n, sn.data(), cs.data(), j1 - j0, pphase + j0, gamma ? gamma + j0 : nullptr,
+                           pvalid ? pvalid + j0 : nullptr, pmask ? pmask + j0 : nullptr, validity);
+            });
+            endValidRow(validity, i);
+        }
+    });
 }
 
-void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase) {
-    if (impaths.size() != 3)
-        throw std::runtime_error("ThreeStepPhaseShifting needs exactly 3 fringe patterns");
+// Bytes read and written by a phase-shifting kernel of n frames
+static std::uint64_t phaseBytes(const cv::Mat* frames, int n, cv::OutputArray _data_modulation, int dtype) {
+    const int noutputs = _data_modulation.needed() ? 2 : 1;
+    return frames[0].total()*(n + noutputs*CV_ELEM_SIZE(dtype));
+}
+
+void detail::nStepPhaseShifting(const cv::Mat* frames, int n, int N, cv::OutputArray _phase,
+                                cv::OutputArray _data_modulation, int dtype, const TileMask& tiles,
+                                ValidityPass* validity) {
+    const std::uint64_t valid_bytes = validity ? frames[0].total() : 0;
+    detail::StageTimer timer(STATS_PHASE, phaseBytes(frames, n, _data_modulation, dtype) + valid_bytes);
+    if (dtype == CV_32F)
+        sl::nStepPhaseShifting<float>(frames, n, N, _phase, _data_modulation, tiles, validity);
+    else
+        sl::nStepPhaseShifting<double>(frames, n, N, _phase, _data_modulation, tiles, validity);
+}
+
+detail::ValidityPass detail::validityPass(const ValidityCriteria& criteria, cv::OutputArray _valid, cv::Size size,
+                                          Workspace* ws, const char* func) {
+    if (criteria.min_modulation < 0 or criteria.saturation < 1 or criteria.saturation > 256)
+        throw std::runtime_error(std::string(func) + ": min_modulation must be >= 0 and saturation in [1, 256]");
     
-    // Read the three fringe images
-    cv::Mat im1 = cv::imread(impaths[0], 0);
-    cv::Mat im2 = cv::imread(impaths[1], 0);
-    cv::Mat im3 = cv::imread(impaths[2], 0);
+    ValidityPass validity{criteria.min_modulation, criteria.saturation, cv::Mat(), cv::Mat()};
+    if (_valid.needed()) {
+        _valid.create(size, CV_8U);
+        validity.valid = _valid.getMat();
+    }
+    else
+        validity.valid = getBuffer(ws, WS_VALID, size, CV_8U);
+    validity.extents = getBuffer(ws, WS_VALID_EXTENTS, cv::Size(rowTiles(size.width), size.height), CV_32SC2);
+    
+    return validity;
+}
+
+/* ---------------------------------------------------------------------------
+Three-step phase-shifting with the closed-form solution
+phase = atan2(sqrt(3)*(I1 - I3), 2*I2 - I1 - I3). The data modulation is only
+estimated when requested.
+--------------------------------------------------------------------------- */
+template <typename T>
+static void threeStepPhaseShifting(const cv::Mat* frames, cv::OutputArray _phase,
+                                   cv::OutputArray _data_modulation, const detail::TileMask& tiles) {
+    const cv::Mat &im1 = frames[0], &im2 = frames[1], &im3 = frames[2];
+    constexpr int depth = cv::traits::Depth<T>::value;
+    
+    if (getPhaseLUT()) {
+        lutPhaseShifting<T>(frames, 3, detail::threeStepLUT<T>(), T(1), [](const uchar* const* I, int j, int& a, int& b) {
+            a = I[0][j] - I[2][j];
+            b = 2*I[1][j] - I[0][j] - I[2][j];
+        }, _phase, _data_modulation, tiles, nullptr);
+        return;
+    }
+    
+    const T sqrt3 = std::sqrt(T(3));
     
     // Set output wrapped phase array
-    _phase.create(im1.size(), CV_64F);
+    _phase.create(im1.size(), depth);
     cv::Mat phase = _phase.getMat();
     
-    // Estimate final wrapped phase with atan2
-    double* pphase = phase.ptr<double>();
-    uchar *pim1 = im1.data, *pim2 = im2.data, *pim3 = im3.data;
-    for (std::size_t i = 0; i < phase.total(); i++) {
-        double I1 = static_cast<double>(pim1[i]);
-        double I2 = static_cast<double>(pim2[i]);
-        double I3 = static_cast<double>(pim3[i]);
-        
-        pphase[i] = std::atan2(std::sqrt(3.)*(I1 - I3), 2*I2 - I1 - I3);
+    // Set output data modulation array
+    cv::Mat data_modulation;
+    if (_data_modulation.needed()) {
+        _data_modulation.create(phase.size(), depth);
+        data_modulation = _data_modulation.getMat();
     }
+    
+    // Estimate final wrapped phase and data modulation arrays
+    detail::parallelForRows(phase.rows, [&](int r0, int r1) {
+        T num[BLOCK_SIZE], den[BLOCK_SIZE];
+        for (int i = r0; i < r1; i++) {
+            T* pphase = phase.ptr<T>(i);
+            T* gamma = data_modulation.empty() ? nullptr : data_modulation.ptr<T>(i);
+            const uchar *pim1 = im1.ptr<uchar>(i), *pim2 = im2.ptr<uchar>(i), *pim3 = im3.ptr<uchar>(i);
+            tiles.forEachRun(i, [&](int c0, int c1) {
+                for (int j0 = c0; j0 < c1; j0 += BLOCK_SIZE) {
+                    const int len = std::min(BLOCK_SIZE, c1 - j0);
+                    for (int j = 0; j < len; j++) {
+                        T I1 = static_cast<T>(pim1[j0 + j]);
+                        T I2 = static_cast<T>(pim2[j0 + j]);
+                        T I3 = static_cast<T>(pim3[j0 + j]);
+                        
+                        num[j] = sqrt3*(I1 - I3);
+                        den[j] = 2*I2 - I1 - I3;
+                    }
+                    
+                    // Data modulation
+                    if (gamma) {
+                        for (int j = 0; j < len; j++) {
+                            T sumI = T(pim1[j0 + j]) + T(pim2[j0 + j]) + T(pim3[j0 + j]);
+                            gamma[j0 + j] = std::sqrt(num[j]*num[j] + den[j]*den[j])/sumI;
+                        }
+                    }
+                    
+                    // Phase map
+                    detail::atan2(num, den, pphase + j0, len);
+                }
+            });
+        }
+    });
 }
 
-void ThreeStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
-                                       cv::OutputArray _data_modulation) {
-    if (impaths.size() != 3)
-        throw std::runtime_error("ThreeStepPhaseShifting_modulation needs exactly 3 fringe patterns");
+static void threeStepPhaseShifting(const cv::Mat* frames, cv::OutputArray _phase,
+                                   cv::OutputArray _data_modulation, int dtype, const detail::TileMask& tiles) {
+    detail::StageTimer timer(STATS_PHASE, phaseBytes(frames, 3, _data_modulation, dtype));
+    if (dtype == CV_32F)
+        threeStepPhaseShifting<float>(frames, _phase, _data_modulation, tiles);
+    else
+        threeStepPhaseShifting<double>(frames, _phase, _data_modulation, tiles);
+}
+
+// Accumulate the N fringe images of one period as they are decoded, and clear the outputs outside of the mask
+static void streamPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase,
+                                cv::OutputArray _data_modulation, int N, int dtype, cv::InputArray mask,
+                                const char* func) {
+    detail::checkFloatDepth(dtype, func);
+    detail::FrameLoader loader(impaths);
+    PhaseShiftAccumulator ps(N, dtype);
+    detail::pushImages(loader, ps, N);
     
-    // Read the three fringe images
-    cv::Mat im1 = cv::imread(impaths[0], 0);
-    cv::Mat im2 = cv::imread(impaths[1], 0);
-    cv::Mat im3 = cv::imread(impaths[2], 0);
+    ps.finalize(_phase, _data_modulation);
+    const detail::TileMask tiles(mask, _phase.size(), nullptr, func);
+    tiles.clearOutside(_phase);
+    tiles.clearOutside(_data_modulation);
+}
+
+void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int N, int dtype,
+                        cv::InputArray mask) {
+    if (N >= 3 and static_cast<int>(impaths.size()) == N)
+        streamPhaseShifting(impaths, _phase, cv::noArray(), N, dtype, mask, "NStepPhaseShifting");
+    else
+        NStepPhaseShifting(detail::readImages(impaths), _phase, N, dtype, nullptr, mask);
+}
+
+void NStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray _phase, int N, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "NStepPhaseShifting");
+    if (frames.size() < 3)
+        throw std::runtime_error("NStepPhaseShifting needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "NStepPhaseShifting");
     
-    // Set output wrapped phase array
-    _phase.create(im1.size(), CV_64F);
-    cv::Mat phase = _phase.getMat();
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, _phase, cv::noArray(), dtype, tiles);
+    tiles.clearOutside(_phase);
+}
+
+void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
+                                   cv::OutputArray _data_modulation, int N, int dtype, cv::InputArray mask) {
+    if (N >= 3 and static_cast<int>(impaths.size()) == N)
+        streamPhaseShifting(impaths, _phase, _data_modulation, N, dtype, mask, "NStepPhaseShifting_modulation");
+    else
+        NStepPhaseShifting_modulation(detail::readImages(impaths), _phase, _data_modulation, N, dtype, nullptr, mask);
+}
+
+void NStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray _phase,
+                                   cv::OutputArray _data_modulation, int N, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "NStepPhaseShifting_modulation");
+    if (frames.size() < 3)
+        throw std::runtime_error("NStepPhaseShifting_modulation needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting_modulation");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "NStepPhaseShifting_modulation");
     
-    // Set output data modulation array
-    _data_modulation.create(phase.size(), phase.type());
-    cv::Mat data_modulation = _data_modulation.getMat();
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, _phase, _data_modulation, dtype, tiles);
+    tiles.clearOutside(_phase);
+    tiles.clearOutside(_data_modulation);
+}
+
+void NStepPhaseShifting_valid(const std::vector<std::string>& impaths, cv::OutputArray _phase, cv::OutputArray _valid,
+                              int N, const ValidityCriteria& criteria, int dtype, cv::InputArray mask) {
+    NStepPhaseShifting_valid(detail::readImages(impaths), _phase, _valid, N, criteria, dtype, nullptr, mask);
+}
+
+void NStepPhaseShifting_valid(cv::InputArrayOfArrays images, cv::OutputArray _phase, cv::OutputArray _valid, int N,
+                              const ValidityCriteria& criteria, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "NStepPhaseShifting_valid");
+    if (frames.size() < 3)
+        throw std::runtime_error("NStepPhaseShifting_valid needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting_valid");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "NStepPhaseShifting_valid");
+    detail::ValidityPass validity = detail::validityPass(criteria, _valid, frames[0].size(), ws, "NStepPhaseShifting_valid");
+    
+    // The validity mask is already 0 outside the mask
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, _phase, cv::noArray(), dtype, tiles, &validity);
+    tiles.clearOutside(_phase);
+}
+
+void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int dtype,
+                            cv::InputArray mask) {
+    ThreeStepPhaseShifting(detail::readImages(impaths), _phase, dtype, nullptr, mask);
+}
+
+void ThreeStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray _phase, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "ThreeStepPhaseShifting");
+    if (frames.size() != 3)
+        throw std::runtime_error("ThreeStepPhaseShifting needs exactly 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "ThreeStepPhaseShifting");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "ThreeStepPhaseShifting");
     
+    threeStepPhaseShifting(frames.data(), _phase, cv::noArray(), dtype, tiles);
+    tiles.clearOutside(_phase);
+}
+
+void ThreeStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
+                                       cv::OutputArray _data_modulation, int dtype, cv::InputArray mask) {
+    ThreeStepPhaseShifting_modulation(detail::readImages(impaths), _phase, _data_modulation, dtype, nullptr, mask);
+}
+
+void ThreeStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray _phase,
+                                       cv::OutputArray _data_modulation, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "ThreeStepPhaseShifting_modulation");
+    if (frames.size() != 3)
+        throw std::runtime_error("ThreeStepPhaseShifting_modulation needs exactly 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "ThreeStepPhaseShifting_modulation");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "ThreeStepPhaseShifting_modulation");
     
-    // Estimate final wrapped phase and data modulation arrays
-    double* pphase = phase.ptr<double>();
-    double* gamma = data_modulation.ptr<double>();
-    uchar *pim1 = im1.data, *pim2 = im2.data, *pim3 = im3.data;
-    for (std::size_t i = 0; i < phase.total(); i++) {
-        double I1 = static_cast<double>(pim1[i]);
-        double I2 = static_cast<double>(pim2[i]);
-        double I3 = static_cast<double>(pim3[i]);
-        
-        double num = std::sqrt(3.)*(I1 - I3);
-        double den = 2*I2 - I1 - I3;
-        
-        // Phase map
-        pphase[i] = std::atan2(num, den);
-        
-        // Data modulation
-        gamma[i] = std::sqrt(num*num + den*den)/(I1 + I2 + I3);
-    }
+    threeStepPhaseShifting(frames.data(), _phase, _data_modulation, dtype, tiles);
+    tiles.clearOutside(_phase);
+    tiles.clearOutside(_data_modulation);
 }
 
 } // namespace sl
@@ -1,5 +1,8 @@
 #include <SLutils/fringe_analysis.hpp>
 
+#include "cuda_mask.hpp" // invalidPixels, clearInvalid
+#include "frames.hpp" // getFrames, readImages, checkFloatDepth
+
 #include <opencv2/cudaarithm.hpp>
 
 #include <stdexcept> // std::runtime_error
@@ -33,6 +36,25 @@ __global__ void N_modulation(const cv::cuda::PtrStepSz<double> sumI,
     data_modulation(i,j) = numerator/sumI(i,j);
 }
 
+// Validity mask: data modulation of at least min_modulation (tested without the square root and
+// the division), no saturated intensity, and inside the optional mask
+__global__ void N_valid(const cv::cuda::PtrStepSz<double> sumI,
+                        const cv::cuda::PtrStep<double> sumIcos,
+                        const cv::cuda::PtrStep<double> sumIsin,
+                        const cv::cuda::PtrStepb maxI, const cv::cuda::PtrStepb mask, bool has_mask,
+                        double min_modulation, int saturation, cv::cuda::PtrStepb valid) {
+    int j = blockIdx.x*blockDim.x + threadIdx.x;
+    int i = blockIdx.y*blockDim.y + threadIdx.y;
+    if (i >= sumI.rows || j >= sumI.cols) return;
+    
+    double a1 = sumIcos(i,j);
+    double a2 = sumIsin(i,j);
+    double m = min_modulation*sumI(i,j);
+    
+    bool ok = maxI(i,j) < saturation && sumI(i,j) > 0 && a1*a1 + a2*a2 >= m*m;
+    valid(i,j) = ok && (!has_mask || mask(i,j)) ? 255 : 0;
+}
+
 __global__ void three_phase(const cv::cuda::PtrStepSzb im1, const cv::cuda::PtrStepb im2,
                             const cv::cuda::PtrStepb im3, cv::cuda::PtrStep<double> phi) {
     int j = blockIdx.x*blockDim.x + threadIdx.x;
@@ -73,15 +95,42 @@ __global__ void three_phase_modulation(const cv::cuda::PtrStepSzb im1,
 }
 
 
-void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int N) {
-    if (impaths.size() < 3)
+// The kernels compute in double precision. For dtype = CV_64F they write directly to the output
+// array, otherwise to a buffer that setOutput converts to dtype
+static cv::cuda::GpuMat getOutputBuffer(cv::OutputArray _dst, cv::Size size, int dtype) {
+    if (dtype == CV_64F) {
+        _dst.create(size, CV_64F);
+        return _dst.getGpuMat();
+    }
+    
+    return cv::cuda::GpuMat(size, CV_64F);
+}
+
+static void setOutput(const cv::cuda::GpuMat& buffer, cv::OutputArray _dst, int dtype) {
+    if (dtype != CV_64F)
+        buffer.convertTo(_dst, dtype);
+}
+
+void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int N, int dtype,
+                        cv::InputArray mask) {
+    NStepPhaseShifting(detail::readImages(impaths), _phase, N, dtype, nullptr, mask);
+}
+
+// The CUDA version does not use the workspace
+void NStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray _phase, int N, int dtype, Workspace*,
+                        cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "NStepPhaseShifting");
+    if (frames.size() < 3)
         throw std::runtime_error("NStepPhaseShifting needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "NStepPhaseShifting");
 
     cv::cuda::Stream stream0;
 
     // Initialize sumIsin and sumIcos with the first fringe image
-    cv::Mat I_h = cv::imread(impaths[0], 0);
-    I_h.convertTo(I_h, CV_64F);
+    cv::Mat I_h;
+    frames[0].convertTo(I_h, CV_64F);
     cv::cuda::GpuMat I(I_h);
     double delta = 2*CV_PI/N; // delta for i = 0
     
@@ -93,9 +142,9 @@ void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray
     
     
     // Add the other fringes to sumIsin and sumIcos
-    for (std::size_t i = 1; i < impaths.size(); i++) {
-        cv::Mat I_h = cv::imread(impaths[i], 0);
-        I_h.convertTo(I_h, CV_64F);
+    for (std::size_t i = 1; i < frames.size(); i++) {
+        cv::Mat I_h;
+        frames[i].convertTo(I_h, CV_64F);
         cv::cuda::GpuMat I(I_h);
         double delta = 2*CV_PI*(i + 1)/N;
 
@@ -104,25 +153,36 @@ void NStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray
     }
     
     // Set output wrapped phase array
-    _phase.create(sumIsin.size(), sumIsin.type());
-    cv::cuda::GpuMat phase = _phase.getGpuMat();
+    cv::cuda::GpuMat phase = getOutputBuffer(_phase, sumIsin.size(), dtype);
     
     // Estimate final wrapped phase with atan2
     dim3 block(16, 16);
     dim3 grid((phase.cols + block.x - 1)/block.x, (phase.rows + block.y - 1)/block.y);
     N_phase<<<grid, block>>>(sumIcos, sumIsin, phase);
+    setOutput(phase, _phase, dtype);
+    detail::clearInvalid(invalid, _phase);
 }
 
 void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
-                                   cv::OutputArray _data_modulation, int N) {
-    if (impaths.size() < 3)
+                                   cv::OutputArray _data_modulation, int N, int dtype, cv::InputArray mask) {
+    NStepPhaseShifting_modulation(detail::readImages(impaths), _phase, _data_modulation, N, dtype, nullptr, mask);
+}
+
+void NStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray _phase,
+                                   cv::OutputArray _data_modulation, int N, int dtype, Workspace*,
+                                   cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "NStepPhaseShifting_modulation");
+    if (frames.size() < 3)
         throw std::runtime_error("NStepPhaseShifting_modulation needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting_modulation");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "NStepPhaseShifting_modulation");
 
     cv::cuda::Stream stream0;
 
     // Initialize sumI, sumIsin, and sumIcos using the first fringe image
-    cv::Mat sumI_h = cv::imread(impaths[0], 0);
-    sumI_h.convertTo(sumI_h, CV_64F);
+    cv::Mat sumI_h;
+    frames[0].convertTo(sumI_h, CV_64F);
     cv::cuda::GpuMat sumI(sumI_h);
     double delta = 2*CV_PI/N; // delta for i = 0
     
@@ -134,9 +194,9 @@ void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::
     
     
     // Add the other fringes to sumI, sumIsin, and sumIcos
-    for (std::size_t i = 1; i < impaths.size(); i++) {
-        cv::Mat I_h = cv::imread(impaths[i], 0);
-        I_h.convertTo(I_h, CV_64F);
+    for (std::size_t i = 1; i < frames.size(); i++) {
+        cv::Mat I_h;
+        frames[i].convertTo(I_h, CV_64F);
         cv::cuda::GpuMat I(I_h);
         double delta = 2*CV_PI*(i + 1)/N;
         
@@ -146,11 +206,11 @@ void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::
     }
     
     // ------------- Estimate final wrapped phase with atan2
-    _phase.create(sumIsin.size(), sumIsin.type());
-    cv::cuda::GpuMat phase = _phase.getGpuMat();
+    cv::cuda::GpuMat phase = getOutputBuffer(_phase, sumIsin.size(), dtype);
     dim3 block(16, 16);
     dim3 grid((phase.cols + block.x - 1)/block.x, (phase.rows + block.y - 1)/block.y);
     N_phase<<<grid, block>>>(sumIcos, sumIsin, phase);
+    setOutput(phase, _phase, dtype);
     
     
     // ----------- Estimate data modulation: sqrt(sumIcos^2 + sumIsin^2)/sumI
@@ -159,70 +219,145 @@ void NStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::
     cv::cuda::sqr(sumIsin, sumIsin, stream0); // sumIsin^2
     cv::cuda::add(sumIcos, sumIsin, numerator, {}, -1, stream0); // sumIcos^2 + sumIsin^2
     cv::cuda::sqrt(numerator, numerator, stream0); // sqrt(sumIcos^2 + sumIsin^2)
-    cv::cuda::divide(numerator, sumI, _data_modulation, 1, -1, stream0);
+    cv::cuda::divide(numerator, sumI, _data_modulation, 1, dtype, stream0);
+    detail::clearInvalid(invalid, _phase);
+    detail::clearInvalid(invalid, _data_modulation);
 }
 
-void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase) {
-    if (impaths.size() != 3)
-        throw std::runtime_error("ThreeStepPhaseShifting needs exactly 3 fringe patterns");
+void NStepPhaseShifting_valid(const std::vector<std::string>& impaths, cv::OutputArray _phase, cv::OutputArray _valid,
+                              int N, const ValidityCriteria& criteria, int dtype, cv::InputArray mask) {
+    NStepPhaseShifting_valid(detail::readImages(impaths), _phase, _valid, N, criteria, dtype, nullptr, mask);
+}
+
+void NStepPhaseShifting_valid(cv::InputArrayOfArrays images, cv::OutputArray _phase, cv::OutputArray _valid, int N,
+                              const ValidityCriteria& criteria, int dtype, Workspace*, cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "NStepPhaseShifting_valid");
+    if (frames.size() < 3)
+        throw std::runtime_error("NStepPhaseShifting_valid needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "NStepPhaseShifting_valid");
+    if (criteria.min_modulation < 0 or criteria.saturation < 1 or criteria.saturation > 256)
+        throw std::runtime_error("NStepPhaseShifting_valid: min_modulation must be >= 0 and saturation in [1, 256]");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "NStepPhaseShifting_valid");
 
     cv::cuda::Stream stream0;
+
+    // Initialize sumI, sumIsin, sumIcos and the maximum intensity maxI using the first fringe image
+    cv::cuda::GpuMat maxI(frames[0]);
+    cv::Mat sumI_h;
+    frames[0].convertTo(sumI_h, CV_64F);
+    cv::cuda::GpuMat sumI(sumI_h);
+    double delta = 2*CV_PI/N; // delta for i = 0
     
-    // Read the three fringe images
-    cv::cuda::GpuMat im1, im2, im3;
+    cv::cuda::GpuMat sumIsin;
+    cv::cuda::multiply(sumI, std::sin(delta), sumIsin, 1, -1, stream0);
+    
+    cv::cuda::GpuMat sumIcos;
+    cv::cuda::multiply(sumI, std::cos(delta), sumIcos, 1, -1, stream0);
     
-    cv::Mat im1_h = cv::imread(impaths[0], 0);
-    im1.upload(im1_h, stream0);
     
-    cv::Mat im2_h = cv::imread(impaths[1], 0);
-    im2.upload(im2_h, stream0);
+    // Add the other fringes to sumI, sumIsin, and sumIcos
+    for (std::size_t i = 1; i < frames.size(); i++) {
+        cv::cuda::GpuMat I8(frames[i]);
+        cv::cuda::GpuMat I;
+        I8.convertTo(I, CV_64F, stream0);
+        double delta = 2*CV_PI*(i + 1)/N;
+        
+        cv::cuda::max(maxI, I8, maxI, stream0); // maxI = max(maxI, I)
+        cv::cuda::add(sumI, I, sumI, {}, -1, stream0); // sumI += I;
+        cv::cuda::scaleAdd(I, std::sin(delta), sumIsin, sumIsin, stream0); // sumIsin += I*std::sin(delta);
+        cv::cuda::scaleAdd(I, std::cos(delta), sumIcos, sumIcos, stream0); // sumIcos += I*std::cos(delta);
+    }
+    
+    // ------------- Estimate final wrapped phase and validity mask
+    cv::cuda::GpuMat phase = getOutputBuffer(_phase, sumIsin.size(), dtype);
+    dim3 block(16, 16);
+    dim3 grid((phase.cols + block.x - 1)/block.x, (phase.rows + block.y - 1)/block.y);
+    N_phase<<<grid, block>>>(sumIcos, sumIsin, phase);
+    setOutput(phase, _phase, dtype);
+    
+    cv::cuda::GpuMat mask_d;
+    if (!invalid.empty())
+        mask_d.upload(mask.getMat());
+    _valid.create(phase.size(), CV_8U);
+    cv::cuda::GpuMat valid = _valid.getGpuMat();
+    N_valid<<<grid, block>>>(sumI, sumIcos, sumIsin, maxI, mask_d, !mask_d.empty(), criteria.min_modulation,
+                             criteria.saturation, valid);
+    detail::clearInvalid(invalid, _phase);
+}
+
+void ThreeStepPhaseShifting(const std::vector<std::string>& impaths, cv::OutputArray _phase, int dtype,
+                            cv::InputArray mask) {
+    ThreeStepPhaseShifting(detail::readImages(impaths), _phase, dtype, nullptr, mask);
+}
+
+void ThreeStepPhaseShifting(cv::InputArrayOfArrays images, cv::OutputArray _phase, int dtype, Workspace*,
+                            cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "ThreeStepPhaseShifting");
+    if (frames.size() != 3)
+        throw std::runtime_error("ThreeStepPhaseShifting needs exactly 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "ThreeStepPhaseShifting");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "ThreeStepPhaseShifting");
+
+    cv::cuda::Stream stream0;
     
-    cv::Mat im3_h = cv::imread(impaths[2], 0);
-    im3.upload(im3_h, stream0);
+    // Upload the three fringe images
+    cv::cuda::GpuMat im1, im2, im3;
+    im1.upload(frames[0], stream0);
+    im2.upload(frames[1], stream0);
+    im3.upload(frames[2], stream0);
     
     
     // Set output wrapped phase array
-    _phase.create(im1.size(), CV_64F);
-    cv::cuda::GpuMat phase = _phase.getGpuMat();
+    cv::cuda::GpuMat phase = getOutputBuffer(_phase, im1.size(), dtype);
     
     // Estimate final wrapped phase with atan2
     dim3 block(16, 16);
     dim3 grid((phase.cols + block.x - 1)/block.x, (phase.rows + block.y - 1)/block.y);
     three_phase<<<grid, block>>>(im1, im2, im3, phase);
+    setOutput(phase, _phase, dtype);
+    detail::clearInvalid(invalid, _phase);
 }
 
 void ThreeStepPhaseShifting_modulation(const std::vector<std::string>& impaths, cv::OutputArray _phase,
-                                       cv::OutputArray _data_modulation) {
-    if (impaths.size() != 3)
+                                       cv::OutputArray _data_modulation, int dtype, cv::InputArray mask) {
+    ThreeStepPhaseShifting_modulation(detail::readImages(impaths), _phase, _data_modulation, dtype, nullptr, mask);
+}
+
+void ThreeStepPhaseShifting_modulation(cv::InputArrayOfArrays images, cv::OutputArray _phase,
+                                       cv::OutputArray _data_modulation, int dtype, Workspace*,
+                                       cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "ThreeStepPhaseShifting_modulation");
+    if (frames.size() != 3)
         throw std::runtime_error("ThreeStepPhaseShifting_modulation needs exactly 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "ThreeStepPhaseShifting_modulation");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "ThreeStepPhaseShifting_modulation");
 
     cv::cuda::Stream stream0;
     
-    // Read the three fringe images
+    // Upload the three fringe images
     cv::cuda::GpuMat im1, im2, im3;
-    
-    cv::Mat im1_h = cv::imread(impaths[0], 0);
-    im1.upload(im1_h, stream0);
-    
-    cv::Mat im2_h = cv::imread(impaths[1], 0);
-    im2.upload(im2_h, stream0);
-    
-    cv::Mat im3_h = cv::imread(impaths[2], 0);
-    im3.upload(im3_h, stream0);
+    im1.upload(frames[0], stream0);
+    im2.upload(frames[1], stream0);
+    im3.upload(frames[2], stream0);
     
     
     // Set output wrapped phase array
-    _phase.create(im1.size(), CV_64F);
-    cv::cuda::GpuMat phase = _phase.getGpuMat();
+    cv::cuda::GpuMat phase = getOutputBuffer(_phase, im1.size(), dtype);
     
     // Set output data modulation array
-    _data_modulation.create(phase.size(), phase.type());
-    cv::cuda::GpuMat data_modulation = _data_modulation.getGpuMat();
+    cv::cuda::GpuMat data_modulation = getOutputBuffer(_data_modulation, im1.size(), dtype);
     
     // Estimate final wrapped phase and data modulation arrays
     dim3 block(16, 16);
     dim3 grid((phase.cols + block.x - 1)/block.x, (phase.rows + block.y - 1)/block.y);
     three_phase_modulation<<<grid, block>>>(im1, im2, im3, phase, data_modulation);
+    setOutput(phase, _phase, dtype);
+    setOutput(data_modulation, _data_modulation, dtype);
+    detail::clearInvalid(invalid, _phase);
+    detail::clearInvalid(invalid, _data_modulation);
 }
 
 } // namespace sl
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SLutils/workspace.hpp>
+
+#include "tile_mask.hpp"
+
+#include <opencv2/core/mat.hpp>
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Convert a gray code word to binary. Each binary bit is the xor of all the gray
+bits above it, which is obtained with log2(32) shifted xors (prefix-xor)
+see: https://www.geeksforgeeks.org/gray-to-binary-and-binary-to-gray-conversion/
+--------------------------------------------------------------------------- */
+inline unsigned gray2bin(unsigned gray) {
+    gray ^= gray >> 1;
+    gray ^= gray >> 2;
+    gray ^= gray >> 4;
+    gray ^= gray >> 8;
+    gray ^= gray >> 16;
+    return gray;
+}
+
+// Decimal map of the graycode images, computed only at the runs of occupied tiles. The images must
+// have the size of the mask. func is the name used in the error messages
+void decimalMap(cv::InputArrayOfArrays images, cv::OutputArray dec, Workspace* ws, const TileMask& tiles,
+                const char* func);
+
+} // namespace sl::detail
@@ -1,139 +1,243 @@
 #include <SLutils/graycoding.hpp>
+#include <SLutils/streaming.hpp> // GrayCodeAccumulator
 
+#include "buffers.hpp" // getFrameList
+#include "frames.hpp" // getFrames, readImages, FrameLoader
+#include "graycode.hpp" // gray2bin
+#include "parallel.hpp" // parallelForRows
+#include "stats.hpp" // StageTimer
+#include "tile_mask.hpp"
+
+#include <opencv2/core/utility.hpp> // cv::AutoBuffer
+
+#include <algorithm> // std::min
 #include <stdexcept> // std::runtime_error
 
 
 namespace sl {
 
-void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec) {
-    if (impaths.size() > 1 and impaths.size() % 2 != 0)
-        throw std::runtime_error("decimalMap requires an even set of images");
-    
-    // Total number of graycode bits (pairs of captured graycode patterns)
-    std::size_t n = impaths.size()/2;
+// Number of pixels of a row processed at once by the gray code decoders
+constexpr int BLOCK_SIZE = 512;
+
+/* ---------------------------------------------------------------------------
+Pack the n gray bits of len pixels into one word per pixel. The bit of the k-th
+pair of graycode images (pattern and inverted pattern) is stored in the bit
+position n - k - 1, i.e. the first pair gives the Most Significant Bit (MSB).
+--------------------------------------------------------------------------- */
+static void packGrayBits(const uchar* const* rows, int n, int len, unsigned* gray) {
+    for (int j = 0; j < len; j++)
+        gray[j] = 0;
     
-    /* -----------------------------------------------------------------------
-    Initialize decimal array (phase order map) 
-    using the first pair of graycode images
-    ----------------------------------------------------------------------- */
-    cv::Mat im1 = cv::imread(impaths[0], 0);
-    cv::Mat im2 = cv::imread(impaths[1], 0);
-    cv::Mat gray = (im1 > im2)/255;
+    for (int k = 0; k < n; k++) {
+        const uchar *im1 = rows[2*k], *im2 = rows[2*k+1];
+        const unsigned bit = 1u << (n - k - 1);
+        for (int j = 0; j < len; j++)
+            gray[j] |= im1[j] > im2[j] ? bit : 0;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+Read the 2n graycode images once, block by block, and write for each pixel
+the packed gray word (Op = gray word) or its decimal value (Op = gray2bin).
+Only the runs of occupied tiles of the mask are read and decoded.
+--------------------------------------------------------------------------- */
+template <typename T, typename Op>
+static void decodeGrayFrames(const std::vector<cv::Mat>& frames, cv::Mat& dst, Op op,
+                             const detail::TileMask& tiles) {
+    const int n = frames.size()/2;
+    detail::StageTimer timer(STATS_GRAYCODE, frames[0].total()*(2*n + sizeof(T)));
     
+    detail::parallelForRows(frames[0].rows, [&](int r0, int r1) {
+        cv::AutoBuffer<const uchar*> rows(2*n);
+        unsigned gray[BLOCK_SIZE];
+        for (int i = r0; i < r1; i++) {
+            T* pdst = dst.ptr<T>(i);
+            tiles.forEachRun(i, [&](int c0, int c1) {
+                for (int j0 = c0; j0 < c1; j0 += BLOCK_SIZE) {
+                    const int len = std::min(BLOCK_SIZE, c1 - j0);
+                    for (int k = 0; k < 2*n; k++)
+                        rows[k] = frames[k].ptr<uchar>(i) + j0;
+                    
+                    packGrayBits(rows.data(), n, len, gray);
+                    for (int j = 0; j < len; j++)
+                        pdst[j0 + j] = static_cast<T>(op(gray[j]));
+                }
+            });
+        }
+    });
+}
+
+static void getGrayFrames(cv::InputArrayOfArrays images, std::vector<cv::Mat>& frames, int max_bits,
+                          const char* func) {
+    detail::getFrames(images, frames, func);
+    if (frames.empty() or frames.size() % 2 != 0)
+        throw std::runtime_error(std::string(func) + " requires an even set of images");
+    if (static_cast<int>(frames.size()/2) > max_bits)
+        throw std::runtime_error(std::string(func) + " supports up to " + std::to_string(max_bits) +
+                                 " graycode bits");
+}
+
+static void decimalMap_(const std::vector<cv::Mat>& frames, cv::OutputArray _dec, const detail::TileMask& tiles) {
     // Create output array that stores graycode words converted to decimal
-    _dec.create(gray.size(), CV_32S);
+    _dec.create(frames[0].size(), CV_32S);
     cv::Mat dec = _dec.getMat();
     
-    // Initialize decimal going from gray to bininary to decimal
-    // First binary value (MSB) is the same from gray
-    uchar* pgray = gray.data;
-    int* pdec = dec.ptr<int>();
-    for (std::size_t i = 0; i < gray.total(); i++)
-        pdec[i] = pgray[i] ? 1 << (n - 1) : 0;
-    
-    
-    /* -----------------------------------------------------------------------
-    Initializing the binary map, which is equal to the graycode map
-    because the Most Significant Bit (MSB) of the binary code = gray code MSB
-    -------------------------------------------------------------------------- */
-    cv::Mat bin = gray; // this not copy data but increases refcount
-    uchar* pbin = bin.data;
-    
-    
-    /* -----------------------------------------------------------------------
-    Adding the rest of graycode patterns to estimate the final phase order
-    -------------------------------------------------------------------------- */
-    for (std::size_t k = 1; k < n; k++) {
-        // Read graycoding pattern and its inverted counterpart
-        cv::Mat im1 = cv::imread(impaths[2*k], 0);
-        cv::Mat im2 = cv::imread(impaths[2*k+1], 0);
-        // Generate a single gray map
-        cv::Mat gray = (im1 > im2) / 255;
-        uchar* pgray = gray.data;
-
-        for (std::size_t i = 0; i < gray.total(); i++) {
-            // Convert current gray code bit to binary bit using xor between 
-            // the previous binary bit and the current gray bit
-            // see: https://www.geeksforgeeks.org/gray-to-binary-and-binary-to-gray-conversion/
-            pbin[i] ^= pgray[i];
-            
-            // if binary bit is 1 then add 2^(bit_pos) to the decimal array
-            if (pbin[i]) pdec[i] += 1 << (n - k - 1);
-        }
+    decodeGrayFrames<int>(frames, dec, detail::gray2bin, tiles);
+}
+
+void detail::decimalMap(cv::InputArrayOfArrays images, cv::OutputArray _dec, Workspace* ws, const TileMask& tiles,
+                        const char* func) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    getGrayFrames(images, frames, 31, func);
+    if (frames[0].size() != tiles.imageSize())
+        throw std::runtime_error(std::string(func) + ": fringe and graycode images must have the same size");
+    
+    decimalMap_(frames, _dec, tiles);
+}
+
+void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec, cv::InputArray mask) {
+    // Accumulate the graycode pairs as they are decoded
+    const int n = static_cast<int>(impaths.size());
+    if (n == 0 or n % 2 != 0 or n/2 > 31) {
+        decimalMap(detail::readImages(impaths), _dec, nullptr, mask);
+        return;
     }
+    
+    detail::FrameLoader loader(impaths);
+    GrayCodeAccumulator gc(n/2);
+    detail::pushImages(loader, gc, n);
+    
+    gc.finalize(_dec);
+    const detail::TileMask tiles(mask, _dec.size(), nullptr, "decimalMap");
+    tiles.clearOutside(_dec);
+}
+
+void decimalMap(cv::InputArrayOfArrays images, cv::OutputArray _dec, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    getGrayFrames(images, frames, 31, "decimalMap");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "decimalMap");
+    
+    decimalMap_(frames, _dec, tiles);
+    tiles.clearOutside(_dec);
+}
+
+void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray _code_word, cv::InputArray mask) {
+    graycodeword(detail::readImages(impaths), _code_word, nullptr, mask);
 }
 
-void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray _code_word) {
-    if (impaths.size() > 1 and impaths.size() % 2 != 0)
+void graycodeword(cv::InputArrayOfArrays images, cv::OutputArray _code_word, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, "graycodeword");
+    if (frames.empty() or frames.size() % 2 != 0)
         throw std::runtime_error("graycodeword requires an even set of images");
     
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "graycodeword");
+    
     // Total number of graycode bits (pairs of captured graycode patterns)
-    int n = impaths.size()/2;
-
-    // Read first image to estimate output array size
-    cv::Size sz = cv::imread(impaths[0], 0).size();
+    int n = frames.size()/2;
 
     // Setting output 3D array as (n,h,w) array with n graycode patterns of (h,w) size
-    int w = sz.width, h = sz.height;
+    int w = frames[0].cols, h = frames[0].rows;
     int dims[] = {n, h, w};
     _code_word.create(3, dims, CV_8U);
     cv::Mat code_word = _code_word.getMat();
 
-    // Estimating gray maps and adding them to the code_word 3D array
-    uchar* pcode_word = code_word.data;
-    for (int k = 0; k < n; k++) {
-        cv::Mat im1 = cv::imread(impaths[2*k], 0);
-        cv::Mat im2 = cv::imread(impaths[2*k+1], 0);
-        
-        cv::Mat bin = (im1 > im2) / 255;
-        uchar* pbin = bin.data;
-        for (int i = 0; i < h; i++)
-            for (int j = 0; j < w; j++)
-                pcode_word[k*w*h + i*w + j] = pbin[i*w + j];
+    // Estimating gray maps directly in the code_word 3D array
+    detail::StageTimer timer(STATS_GRAYCODE, frames[0].total()*3*n);
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        for (int k = 0; k < n; k++) {
+            for (int i = r0; i < r1; i++) {
+                const uchar *pim1 = frames[2*k].ptr<uchar>(i), *pim2 = frames[2*k+1].ptr<uchar>(i);
+                uchar* pcode_word = code_word.ptr<uchar>(k, i);
+                tiles.forEachRun(i, [&](int j0, int j1) {
+                    for (int j = j0; j < j1; j++)
+                        pcode_word[j] = pim1[j] > pim2[j];
+                });
+            }
+        }
+    });
+    
+    // Clear each gray map outside the mask
+    for (int k = 0; tiles.hasMask() and k < n; k++) {
+        cv::Mat gray_map(h, w, CV_8U, code_word.ptr<uchar>(k));
+        tiles.clearOutside(gray_map);
     }
 }
 
-void gray2dec(cv::InputArray _code_word, cv::OutputArray _dec) {
-    if (_code_word.dims() != 3)
-        throw std::runtime_error("gray2dec: code_word must be a 3D array");
+void graycodewordPacked(const std::vector<std::string>& impaths, cv::OutputArray _code_word, cv::InputArray mask) {
+    graycodewordPacked(detail::readImages(impaths), _code_word, nullptr, mask);
+}
+
+void graycodewordPacked(cv::InputArrayOfArrays images, cv::OutputArray _code_word, Workspace* ws,
+                        cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    getGrayFrames(images, frames, 16, "graycodewordPacked");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "graycodewordPacked");
+    
+    // Setting output 2D array with a 16-bit gray word per pixel
+    _code_word.create(frames[0].size(), CV_16U);
+    cv::Mat code_word = _code_word.getMat();
+    
+    decodeGrayFrames<ushort>(frames, code_word, [](unsigned gray) { return gray; }, tiles);
+    tiles.clearOutside(code_word);
+}
 
+void gray2dec(cv::InputArray _code_word, cv::OutputArray _dec) {
     cv::Mat code_word = _code_word.getMat();
+    
+    // Bit-packed code word: a (h,w) array of 16-bit gray words
+    if (code_word.dims == 2 and code_word.type() == CV_16UC1) {
+        _dec.create(code_word.size(), CV_32S);
+        cv::Mat dec = _dec.getMat();
+        
+        detail::parallelForRows(code_word.rows, [&](int r0, int r1) {
+            for (int i = r0; i < r1; i++) {
+                const ushort* pcode_word = code_word.ptr<ushort>(i);
+                int* pdec = dec.ptr<int>(i);
+                for (int j = 0; j < code_word.cols; j++)
+                    pdec[j] = detail::gray2bin(pcode_word[j]);
+            }
+        });
+        return;
+    }
+    
+    if (code_word.dims != 3 or code_word.type() != CV_8UC1)
+        throw std::runtime_error("gray2dec: code_word must be a 3D (n,h,w) 8-bit array or a 2D 16-bit packed array");
+    
     int n = code_word.size[0], h = code_word.size[1], w = code_word.size[2];
+    if (n > 31)
+        throw std::runtime_error("gray2dec supports up to 31 graycode bits");
 
-    // Output array (init with zeros) to store graycode words converted to decimal
+    // Output array to store graycode words converted to decimal
     _dec.create(h, w, CV_32S);
     cv::Mat dec = _dec.getMat();
-    // array to store graycode bits converted to binary
-    cv::Mat bin(h, w, CV_8U);
-    
-    
-    /* -------------------------------------------------------------------------------------------
-    // Init decimal and bin arrays knowing that first bin value (MSB) is equal to the gray value
-    // We only use pcode_word[i] because this get all the values of the first gray map
-    ------------------------------------------------------------------------------------------- */
-    int* pdec = dec.ptr<int>();
-    uchar* pbin = bin.data;
-    uchar* pcode_word = code_word.data;
-    for (std::size_t i = 0; i < dec.total(); i++) {
-        uchar graybit = pcode_word[i];
-        pdec[i] = graybit ? 1 << (n - 1) : 0;
-        pbin[i] = graybit;
-    }
     
-    /* -----------------------------------------------------------------------
-    Adding the rest of graycode patterns to estimate the final phase order
-    -------------------------------------------------------------------------- */
-    for (int k = 1; k < n; k++) {
-        for (std::size_t i = 0; i < dec.total(); i++) {
-            // Convert current gray code bit to binary bit using xor between 
-            // the previous binary bit and the current gray bit
-            // see: https://www.geeksforgeeks.org/gray-to-binary-and-binary-to-gray-conversion/
-            pbin[i] ^= pcode_word[k*w*h + i];
-            
-            // if binary bit is 1 then add 2^(bit_pos) to the decimal array
-            if (pbin[i]) pdec[i] += 1 << (n - k - 1);
+    // Pack the n gray bits of each pixel and convert the gray words to decimal
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        unsigned gray[BLOCK_SIZE];
+        for (int i = r0; i < r1; i++) {
+            int* pdec = dec.ptr<int>(i);
+            for (int j0 = 0; j0 < w; j0 += BLOCK_SIZE) {
+                const int len = std::min(BLOCK_SIZE, w - j0);
+                for (int j = 0; j < len; j++)
+                    gray[j] = 0;
+                
+                for (int k = 0; k < n; k++) {
+                    const uchar* pcode_word = code_word.ptr<uchar>(k, i) + j0;
+                    const unsigned bit = 1u << (n - k - 1);
+                    for (int j = 0; j < len; j++)
+                        gray[j] |= pcode_word[j] ? bit : 0;
+                }
+                
+                for (int j = 0; j < len; j++)
+                    pdec[j0 + j] = detail::gray2bin(gray[j]);
+            }
         }
-    }
+    });
 }
 
 } // namespace sl
@@ -1,5 +1,8 @@
 #include <SLutils/graycoding.hpp>
 
+#include "cuda_mask.hpp" // invalidPixels, clearInvalid
+#include "frames.hpp" // getFrames, readImages
+
 #include <opencv2/core/cuda.hpp>
 #include <stdexcept> // std::runtime_error
 
@@ -64,15 +67,47 @@ __global__ void dec_array(const cv::cuda::PtrStepSzb im1, const cv::cuda::PtrSte
     if (bin(i,j)) decimal(i,j) += 1 << (n_bits - pos - 1);
 }
 
+__global__ void packGrayBit(const cv::cuda::PtrStepSzb im1, const cv::cuda::PtrStepb im2,
+                            cv::cuda::PtrStep<ushort> code_word, int pos) {
+    int j = blockIdx.x*blockDim.x + threadIdx.x;
+    int i = blockIdx.y*blockDim.y + threadIdx.y;
+    if (i >= im1.rows || j >= im1.cols) return;
+    
+    // Set the graycode bit in its position of the packed gray word
+    if (im1(i,j) > im2(i,j)) code_word(i,j) |= 1 << pos;
+}
 
-void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec) {
-    if (impaths.size() > 1 and impaths.size() % 2 != 0)
+__global__ void packedGray2dec(const cv::cuda::PtrStepSz<ushort> code_word, cv::cuda::PtrStepi decimal) {
+    int j = blockIdx.x*blockDim.x + threadIdx.x;
+    int i = blockIdx.y*blockDim.y + threadIdx.y;
+    if (i >= code_word.rows || j >= code_word.cols) return;
+    
+    // Convert gray word to binary: each binary bit is the xor of all the gray bits above it
+    unsigned gray = code_word(i,j);
+    gray ^= gray >> 1;
+    gray ^= gray >> 2;
+    gray ^= gray >> 4;
+    gray ^= gray >> 8;
+    decimal(i,j) = gray;
+}
+
+
+void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec, cv::InputArray mask) {
+    decimalMap(detail::readImages(impaths), _dec, nullptr, mask);
+}
+
+// The CUDA version does not use the workspace
+void decimalMap(cv::InputArrayOfArrays images, cv::OutputArray _dec, Workspace*, cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "decimalMap");
+    if (frames.empty() or frames.size() % 2 != 0)
         throw std::runtime_error("decimalMap requires an even set of images");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "decimalMap");
 
     cv::cuda::Stream stream0;
     
     // Total number of graycode bits (pairs of captured graycode patterns)
-    int n = impaths.size()/2;
+    int n = frames.size()/2;
     
 
     /* -----------------------------------------------------------------------
@@ -80,20 +115,18 @@ void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec) {
     graycode images. Also the binary map, which is equal to the graycode map
     because the Most Significant Bit (MSB) of the binary code = MSB gray code
     ----------------------------------------------------------------------- */
-    cv::Mat im1_h = cv::imread(impaths[0], 0);
     cv::cuda::GpuMat im1;
-    im1.upload(im1_h, stream0);
+    im1.upload(frames[0], stream0);
     
-    cv::Mat im2_h = cv::imread(impaths[1], 0);
     cv::cuda::GpuMat im2;
-    im2.upload(im2_h, stream0);
+    im2.upload(frames[1], stream0);
 
     // Allocate output decimal array which is obtained from graycode words
-    _dec.create(im1_h.size(), CV_32S);
+    _dec.create(frames[0].size(), CV_32S);
     cv::cuda::GpuMat dec = _dec.getGpuMat();
     
     // Allocate binary array
-    cv::cuda::GpuMat bin(im1_h.size(), CV_8U);
+    cv::cuda::GpuMat bin(frames[0].size(), CV_8U);
 
     // Launching initDecimalAndBinary to initialize the values of dec and bin
     dim3 block(16, 16);
@@ -105,40 +138,42 @@ void decimalMap(const std::vector<std::string>& impaths, cv::OutputArray _dec) {
     Adding the rest of graycode patterns to estimate the final phase order
     -------------------------------------------------------------------------- */
     for (int i = 1; i < n; i++) {
-        // Read graycoding pattern and its inverted counterpart
-        cv::Mat im1_h = cv::imread(impaths[2*i], 0);
+        // Upload graycoding pattern and its inverted counterpart
         cv::cuda::GpuMat im1;
-        im1.upload(im1_h, stream0);
+        im1.upload(frames[2*i], stream0);
         
-        cv::Mat im2_h = cv::imread(impaths[2*i+1], 0);
         cv::cuda::GpuMat im2;
-        im2.upload(im2_h, stream0);
+        im2.upload(frames[2*i+1], stream0);
 
         dec_array<<<grid, block>>>(im1, im2, bin, dec, n, i);
     }
+    detail::clearInvalid(invalid, _dec);
 }
 
-void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray _code_word) {
-    if (impaths.size() > 1 and impaths.size() % 2 != 0)
+void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray _code_word, cv::InputArray mask) {
+    graycodeword(detail::readImages(impaths), _code_word, nullptr, mask);
+}
+
+void graycodeword(cv::InputArrayOfArrays images, cv::OutputArray _code_word, Workspace*, cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "graycodeword");
+    if (frames.empty() or frames.size() % 2 != 0)
         throw std::runtime_error("graycodeword requires an even set of images");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "graycodeword");
 
     cv::cuda::Stream stream0;
     
     // Total number of graycode bits (pairs of captured graycode patterns)
-    int n = impaths.size()/2;
-
-    // Read first image to obtain the output array size
-    cv::Size sz = cv::imread(impaths[0], 0).size();
+    int n = frames.size()/2;
 
     // Get output vector of arrays
     std::vector<cv::cuda::GpuMat>& gray_images = _code_word.getGpuMatVecRef();
 
     for (int k = 0; k < n; k++) {
-        // Read graycoding pattern and its inverted counterpart
-        cv::Mat im1 = cv::imread(impaths[2*k], 0);
-        cv::Mat im2 = cv::imread(impaths[2*k+1], 0);
-        // Generate a single gray map
-        cv::Mat gray_h = (im1 > im2)/255;
+        // Generate a single gray map from the graycoding pattern and its inverted counterpart
+        cv::Mat gray_h = (frames[2*k] > frames[2*k+1])/255;
+        if (!invalid.empty())
+            gray_h.setTo(0, invalid);
 
         // Convert to GPU with continuous memory block of byte data
         cv::cuda::GpuMat gray;
@@ -147,7 +182,59 @@ void graycodeword(const std::vector<std::string>& impaths, cv::OutputArray _code
     }
 }
 
+void graycodewordPacked(const std::vector<std::string>& impaths, cv::OutputArray _code_word, cv::InputArray mask) {
+    graycodewordPacked(detail::readImages(impaths), _code_word, nullptr, mask);
+}
+
+void graycodewordPacked(cv::InputArrayOfArrays images, cv::OutputArray _code_word, Workspace*,
+                        cv::InputArray mask) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, "graycodewordPacked");
+    if (frames.empty() or frames.size() % 2 != 0)
+        throw std::runtime_error("graycodewordPacked requires an even set of images");
+    if (frames.size()/2 > 16)
+        throw std::runtime_error("graycodewordPacked supports up to 16 graycode bits");
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), "graycodewordPacked");
+
+    cv::cuda::Stream stream0;
+    
+    // Total number of graycode bits (pairs of captured graycode patterns)
+    int n = frames.size()/2;
+    
+    // Allocate output array with a 16-bit gray word per pixel
+    _code_word.create(frames[0].size(), CV_16U);
+    cv::cuda::GpuMat code_word = _code_word.getGpuMat();
+    code_word.setTo(0);
+    
+    dim3 block(16, 16);
+    dim3 grid((code_word.cols + block.x - 1)/block.x, (code_word.rows + block.y - 1)/block.y);
+    for (int k = 0; k < n; k++) {
+        // Upload graycoding pattern and its inverted counterpart
+        cv::cuda::GpuMat im1;
+        im1.upload(frames[2*k], stream0);
+        
+        cv::cuda::GpuMat im2;
+        im2.upload(frames[2*k+1], stream0);
+        
+        packGrayBit<<<grid, block>>>(im1, im2, code_word, n - k - 1);
+    }
+    detail::clearInvalid(invalid, _code_word);
+}
+
 void gray2dec(cv::InputArray _code_word, cv::OutputArray _dec) {
+    // Bit-packed code word: a single array of 16-bit gray words
+    if (_code_word.kind() == cv::_InputArray::CUDA_GPU_MAT and _code_word.type() == CV_16UC1) {
+        cv::cuda::GpuMat code_word = _code_word.getGpuMat();
+        
+        _dec.create(code_word.size(), CV_32S);
+        cv::cuda::GpuMat dec = _dec.getGpuMat();
+        
+        dim3 block(16, 16);
+        dim3 grid((dec.cols + block.x - 1)/block.x, (dec.rows + block.y - 1)/block.y);
+        packedGray2dec<<<grid, block>>>(code_word, dec);
+        return;
+    }
+    
     // Obtain input vector of GpuMats
     std::vector<cv::cuda::GpuMat> code_word;
     _code_word.getGpuMatVector(code_word);
@@ -1,146 +1,403 @@
 #include <SLutils/multifrequency.hpp>
+#include <SLutils/config.hpp> // getNumThreads
+#include <SLutils/streaming.hpp> // PhaseShiftAccumulator
 
-#include <SLutils/fringe_analysis.hpp> // NStepPhaseShifting
+#include "buffers.hpp" // getBuffer, getFrameList
+#include "frames.hpp" // getFrames, readImages, FrameLoader, checkFloatDepth
+#include "parallel.hpp" // parallelForRows, parallelForEach
+#include "phase_shifting.hpp" // nStepPhaseShifting
+#include "spiky_noise.hpp" // spikeMedian
+#include "stats.hpp" // StageTimer, recordSpikeCorrections
+#include "tile_mask.hpp"
+#include "unwrap.hpp"
+#include "unwrap_chain.hpp" // buildUnwrapChain, checkFrequencies
 
-#include <cmath> // std::fmod
+#include <algorithm> // std::min, std::max, std::sort, std::lower_bound
+#include <cmath> // std::remainder
+#include <cstdint> // std::int64_t
+#include <limits> // std::numeric_limits
+#include <numeric> // std::lcm
+#include <stdexcept> // std::runtime_error
 
 
 namespace sl {
 
-static cv::Mat equivalentPhase(cv::InputArray _phase1, cv::InputArray _phase2) {
-    constexpr double twoPI = 2*CV_PI;
+// Equivalent phase of two wrapped phase values as mod(phase1-phase2, 2*pi)
+template <typename T>
+static inline T equivalentPhase(T phase1, T phase2) {
+    const T twoPI = static_cast<T>(2*CV_PI);
     
-    // Get input arrays
-    cv::Mat phase1 = _phase1.getMat();
-    cv::Mat phase2 = _phase2.getMat();
+    T diff = phase1 - phase2;
     
-    // Set output array
-    cv::Mat eqPhase(phase1.size(), phase1.type());
+    T mod = std::remainder(diff, twoPI);
+    if (mod < 0) mod += twoPI;
+    return mod;
+}
+
+// Unwrap phase2 with the unwrapped phase1 of period T1, where ratio = T1/T2
+template <typename T>
+static inline T backwardUnwrap(T phase1, T phase2, T ratio) {
+    // Estimate phase order
+    T k = (ratio*phase1 - phase2)/2/static_cast<T>(CV_PI);
+    
+    // Unwrap phase value
+    return phase2 + 2*static_cast<T>(CV_PI)*cvRound(k);
+}
+
+// Remove the 2*pi spike of an unwrapped phase value using its 5x5 median Phim
+template <typename T>
+static inline T removeSpike(T Phi, float Phim) {
+    T n = (Phi - Phim)/2/static_cast<T>(CV_PI);
+    return Phi - 2*static_cast<T>(CV_PI)*cvRound(n);
+}
+
+/* ---------------------------------------------------------------------------
+Fused heterodyne unwrapping. The rows are processed in tiles of TILE_ROWS
+rows, split in one band of tiles per thread. For each tile,
+wideRow(y, x0, x1, dst) computes the equivalent phase of widest pitch of the
+columns [x0, x1) of row y in single precision, also for MEDIAN_HALO rows
+above and below the tile, which are needed by the 5x5 median filter. Then
+chainRow(y, x0, x1, median) computes the unwrapped phase of those columns
+from the wrapped phases and the median of their wide phase, which is only
+computed at the spike candidates (see spikeMedian). Only two tile
+buffers per thread are used instead of full intermediate images, and the
+results are the same as filtering the whole wide phase map. With a mask, the
+columns are the spans of the runs of the tile (expanded by the halo), and
+the tiles without runs are skipped.
+--------------------------------------------------------------------------- */
+template <typename WideRow, typename ChainRow>
+static void fusedUnwrap(int h, int w, Workspace* ws, const detail::TileMask& tiles, const WideRow& wideRow,
+                        const ChainRow& chainRow) {
+    constexpr int TILE_ROWS = 64;
+    constexpr int MEDIAN_HALO = 2;
+    constexpr int BUFFER_ROWS = TILE_ROWS + 2*MEDIAN_HALO;
+    static_assert(TILE_ROWS <= detail::TileMask::TILE, "the rows of a tile must be in at most two tile rows of the mask");
     
-    // Estimate equivalent phase as mod(phase1-phase2, 2*pi)
-    const double* pphase1 = phase1.ptr<double>();
-    const double* pphase2 = phase2.ptr<double>();
-    double* peqPhase = eqPhase.ptr<double>();
-    for (std::size_t i = 0; i < phase1.total(); i++) {
-        double diff = pphase1[i] - pphase2[i];
+    // Tile buffers of each band. The median buffer only holds the median at the spike candidates
+    const int nbands = std::max(1, std::min(getNumThreads(), (h + TILE_ROWS - 1)/TILE_ROWS));
+    cv::Mat wide = detail::getBuffer(ws, detail::WS_TILES_WIDE, {w, nbands*BUFFER_ROWS}, CV_32F);
+    cv::Mat median = detail::getBuffer(ws, detail::WS_TILES_MEDIAN, {w, nbands*BUFFER_ROWS}, CV_32F);
+    cv::Mat range = detail::getBuffer(ws, detail::WS_TILES_RANGE, {w, 2*nbands}, CV_32F);
+    
+    detail::parallelForEach(nbands, [&](int b) {
+        const int r0 = b*h/nbands, r1 = (b + 1)*h/nbands;
+        float *cmin = range.ptr<float>(2*b), *cmax = range.ptr<float>(2*b + 1);
         
-        double mod = std::remainder(diff, twoPI);
-        if (mod < 0) mod += twoPI;
-        peqPhase[i] = mod;
+        for (int t0 = r0; t0 < r1; t0 += TILE_ROWS) {
+            // Rows of the tile and of the tile with its halo
+            const int t1 = std::min(t0 + TILE_ROWS, r1);
+            const int h0 = std::max(t0 - MEDIAN_HALO, 0), h1 = std::min(t1 + MEDIAN_HALO, h);
+            
+            tiles.forEachSpan(t0, t1, MEDIAN_HALO, [&](int x0, int x1) {
+                const cv::Range rows(b*BUFFER_ROWS, b*BUFFER_ROWS + h1 - h0), cols(0, x1 - x0);
+                cv::Mat tile_wide = wide(rows, cols);
+                cv::Mat tile_median = median(rows, cols);
+                for (int y = h0; y < h1; y++)
+                    wideRow(y, x0, x1, tile_wide.ptr<float>(y - h0));
+                
+                // The borders of the tile are replicated only at the image borders
+                detail::spikeMedian(tile_wide, tile_median, cv::Range(t0 - h0, t1 - h0), cmin, cmax);
+                
+                // Each run of the tile lies in one span
+                for (int y = t0; y < t1; y++) {
+                    tiles.forEachRun(y, [&](int j0, int j1) {
+                        if (j0 >= x0 and j1 <= x1)
+                            chainRow(y, j0, j1, tile_median.ptr<float>(y - h0) + j0 - x0);
+                    });
+                }
+            });
+        }
+    });
+}
+
+/* ---------------------------------------------------------------------------
+Heterodyne or hierarchical unwrapping with the backward unwrapping chain of
+the K wrapped phase maps. The wide phase is computed per pixel and its
+spikes are removed with its median. Then the equivalent phases and the
+chain are evaluated in registers, and only the output phase is written.
+--------------------------------------------------------------------------- */
+template <typename T>
+static void chainUnwrap(const cv::Mat* phases, const detail::UnwrapChain& chain, cv::Mat& Phi, Workspace* ws,
+                        const detail::TileMask& tiles) {
+    const int K = chain.K;
+    
+    // Period ratios of the chain
+    T ratio[2*detail::MAX_FREQUENCIES];
+    double prev_period = chain.wide_period;
+    for (int s = 0; s < chain.nsteps; s++) {
+        ratio[s] = static_cast<T>(prev_period/chain.period[s]);
+        prev_period = chain.period[s];
     }
     
-    return eqPhase;
+    auto getRows = [&](int y, const T** p) {
+        for (int i = 0; i < K; i++)
+            p[i] = phases[i].ptr<T>(y);
+    };
+    
+    // The wide phase has no discontinuities
+    auto widePhase = [&](const T* const* p, int x) {
+        if (chain.wide >= 0)
+            return equivalentPhase(p[chain.wide][x], T(0));
+        
+        T Phi = equivalentPhase(p[0][x], p[1][x]);
+        for (int i = 2; i < K; i++)
+            Phi = equivalentPhase(Phi, p[i][x]);
+        return Phi;
+    };
+    
+    auto wideRow = [&](int y, int x0, int x1, float* dst) {
+        const T* p[detail::MAX_FREQUENCIES];
+        getRows(y, p);
+        for (int x = x0; x < x1; x++)
+            dst[x - x0] = static_cast<float>(widePhase(p, x));
+    };
+    
+    auto chainRow = [&](int y, int x0, int x1, const float* median) {
+        const T* p[detail::MAX_FREQUENCIES];
+        getRows(y, p);
+        T* pPhi = Phi.ptr<T>(y);
+        std::uint64_t spikes = 0;
+        for (int x = x0; x < x1; x++) {
+            const T wide = widePhase(p, x);
+            T Phix = removeSpike(wide, median[x - x0]);
+            if constexpr (detail::STATS_ENABLED)
+                spikes += Phix != wide;
+            
+            // Backward phase unwrapping
+            for (int s = 0; s < chain.nsteps; s++) {
+                const int i = chain.index[s];
+                const T phase = i < K ? p[i][x] : equivalentPhase(p[i-K][x], p[i-K+1][x]);
+                Phix = backwardUnwrap(Phix, phase, ratio[s]);
+            }
+            
+            pPhi[x] = Phix;
+        }
+        if constexpr (detail::STATS_ENABLED)
+            detail::recordSpikeCorrections(spikes);
+    };
+    
+    fusedUnwrap(Phi.rows, Phi.cols, ws, tiles, wideRow, chainRow);
 }
 
-static void backwardUnwrap(cv::InputArray _phase1, cv::InputOutputArray _phase2, double T1, double T2) {
-    cv::Mat phase1 = _phase1.getMat();
-    cv::Mat phase2 = _phase2.getMat();
-    
-    const double* pphase1 = phase1.ptr<double>();
-    double* pphase2 = phase2.ptr<double>();
-    for (std::size_t i = 0; i < phase1.total(); i++) {
-        double phi2 = pphase2[i];
+/* ---------------------------------------------------------------------------
+Number-theoretic unwrapping. For integer periods, the projector coordinate
+x in [0, L), with L the least common multiple of the periods, has fringe
+orders k_i = floor(x/T_i). Hence d_i = T_1*k_1 - T_i*k_i = T_i*f_i - T_1*f_1,
+where f_i in [0, 1) are the normalized wrapped phases, are integers whose
+values identify k_1. The table of (d_2, ..., d_K) -> k_1 is built by
+enumerating x, and the rounded d_i of each pixel are looked up in it. When
+the periods share a common factor, a vector can match several orders: these
+pixels are set to NaN, as the pixels whose vector is not in the table.
+--------------------------------------------------------------------------- */
+
+// Maximum least common multiple of the periods (size of the enumeration)
+constexpr std::int64_t MAX_CRT_RANGE = 1 << 20;
+
+// Entry of the lookup table, stored in a CV_32SC4 workspace buffer
+struct CrtEntry {
+    std::int64_t key;
+    int order, unused;
+};
+static_assert(sizeof(CrtEntry) == 16, "a table entry must fit in a CV_32SC4 element");
+
+// Table of the keys of the (d_2, ..., d_K) vectors and the phase order k_1 of each key, sorted by key.
+// Returns the number of entries. The key is sum((d_i + T_1)*stride[i]), with d_i + T_1 in [0, T_1 + T_i].
+// A key reached by several phase orders is ambiguous and gets the order -1
+static int buildCrtTable(const int* periods, int K, Workspace* ws, cv::Mat& table, std::int64_t* stride) {
+    std::int64_t L = 1;
+    stride[1] = 1;
+    for (int i = 1; i < K; i++) {
+        L = std::lcm(L, static_cast<std::int64_t>(std::lcm(periods[0], periods[i])));
+        if (L > MAX_CRT_RANGE)
+            throw std::runtime_error("multiFreqPhaseUnwrap: the least common multiple of the periods is too large");
         
-        // Estimate phase order
-        double k = (T1/T2*pphase1[i] - phi2)/2/CV_PI;
+        const std::int64_t range = periods[0] + periods[i] + 1;
+        if (stride[i] > std::numeric_limits<std::int64_t>::max()/range)
+            throw std::runtime_error("multiFreqPhaseUnwrap: the periods are too large for the number-theoretic method");
+        if (i+1 < K)
+            stride[i+1] = stride[i]*range;
+    }
+    
+    table = detail::getBuffer(ws, detail::WS_CRT_TABLE, {static_cast<int>(L), 1}, CV_32SC4);
+    CrtEntry* entries = table.ptr<CrtEntry>();
+    int n = 0;
+    for (std::int64_t x = 0; x < L; x++) {
+        const int k1 = x/periods[0];
+        std::int64_t key = 0;
+        for (int i = 1; i < K; i++)
+            key += (periods[0]*k1 - periods[i]*(x/periods[i]) + periods[0])*stride[i];
         
-        // Unwrap phase value
-        pphase2[i] = phi2 + 2*CV_PI*cvRound(k);
+        if (n == 0 or entries[n-1].key != key)
+            entries[n++] = {key, k1, 0};
+    }
+    
+    std::sort(entries, entries + n, [](const CrtEntry& a, const CrtEntry& b) {
+        return a.key < b.key;
+    });
+    
+    // Merge the entries of each key
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (m > 0 and entries[m-1].key == entries[i].key) {
+            if (entries[m-1].order != entries[i].order)
+                entries[m-1].order = -1;
+        }
+        else
+            entries[m++] = entries[i];
     }
+    
+    return m;
 }
 
-void threeFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
-                          const cv::Vec3i& p, const cv::Vec3i& N) {
-    if (impaths.size() != (N[0]+N[1]+N[2]))
-        throw std::runtime_error("threeFreqPhaseUnwrap: number of image paths and number of patterns N must match");
-    
-    // Get input fringe periods
-    double T1 = p[0], T2 = p[1], T3 = p[2];
-    // Estimate equivalent intermidate periods
-    double T12 = T1*T2/std::abs(T1-T2);
-    double T23 = T2*T3/std::abs(T2-T3);
-    double T123 = T12*T3/std::abs(T12-T3);
-    
-    // Estimating wrapped phase map for each frequency
-    cv::Mat phi1, phi2, phi3;
-    NStepPhaseShifting({impaths.begin(), impaths.begin()+N[0]}, phi1, N[0]);
-    NStepPhaseShifting({impaths.begin()+N[0], impaths.begin()+N[0]+N[1]}, phi2, N[1]);
-    NStepPhaseShifting({impaths.end()-N[2], impaths.end()}, phi3, N[2]);
-    
-    // Estimate equivalent phase maps
-    cv::Mat phi12 = equivalentPhase(phi1, phi2);
-    cv::Mat phi23 = equivalentPhase(phi2, phi3);
-    cv::Mat Phi123 = equivalentPhase(phi12, phi3); // Phi123 is a wide phase without discontinuities
-    
-    // Remove spiky noise in the equivalent phase of wider pitch
-    cv::Mat Phi123m;
-    Phi123.convertTo(Phi123m, CV_32F); // cv::medianBlur needs float input Mat
-    cv::medianBlur(Phi123m, Phi123m, 5);
-    
-    double* pPhi123 = Phi123.ptr<double>();
-    float* pPhi123m = Phi123m.ptr<float>();
-    for (std::size_t i = 0; i < Phi123.total(); i++) {        
-        // Estimate phase order difference between phase and filtered phase
-        double n = (pPhi123[i] - pPhi123m[i])/2/CV_PI;
-        // Estimate 2*pi multiple to remove the spike (rounding n to nearest int)
-        // For pixels with no spikes rounded n must be 0 and no offset is applied
-        double offset = 2*CV_PI*cvRound(n);
-        
-        // Correct phase value
-        pPhi123[i] -= offset;
+template <typename T>
+static void crtUnwrap(const cv::Mat* phases, const int* periods, int K, cv::Mat& Phi, Workspace* ws,
+                      const detail::TileMask& tiles) {
+    cv::Mat table;
+    std::int64_t stride[detail::MAX_FREQUENCIES];
+    const int n = buildCrtTable(periods, K, ws, table, stride);
+    const CrtEntry *first = table.ptr<CrtEntry>(), *last = first + n;
+    
+    const T twoPI = static_cast<T>(2*CV_PI);
+    
+    detail::parallelForRows(Phi.rows, [&](int r0, int r1) {
+        for (int y = r0; y < r1; y++) {
+            const T* p[detail::MAX_FREQUENCIES];
+            for (int i = 0; i < K; i++)
+                p[i] = phases[i].ptr<T>(y);
+            T* pPhi = Phi.ptr<T>(y);
+            
+            tiles.forEachRun(y, [&](int x0, int x1) {
+                for (int x = x0; x < x1; x++) {
+                    const T phi1 = equivalentPhase(p[0][x], T(0));
+                    const T f1 = phi1/twoPI;
+                    
+                    // Get the key of the rounded d_i
+                    std::int64_t key = 0;
+                    bool valid = true;
+                    for (int i = 1; i < K; i++) {
+                        const int d = cvRound(periods[i]*(equivalentPhase(p[i][x], T(0))/twoPI) - periods[0]*f1);
+                        valid = valid and d >= -periods[0] and d <= periods[i];
+                        key += (d + periods[0])*stride[i];
+                    }
+                    
+                    const CrtEntry* it = std::lower_bound(first, last, key, [](const CrtEntry& e, std::int64_t k) {
+                        return e.key < k;
+                    });
+                    if (valid and it != last and it->key == key and it->order >= 0)
+                        pPhi[x] = phi1 + twoPI*it->order;
+                    else
+                        pPhi[x] = std::numeric_limits<T>::quiet_NaN();
+                }
+            });
+        }
+    });
+}
+
+void detail::multiFreqUnwrap(const cv::Mat* phases, const int* periods, int K, MultiFreqMethod method,
+                             cv::OutputArray _Phi, Workspace* ws, const TileMask& tiles, const char* func) {
+    _Phi.create(phases[0].size(), phases[0].type());
+    cv::Mat Phi = _Phi.getMat();
+    StageTimer timer(STATS_UNWRAP, Phi.total()*Phi.elemSize()*(K + 1));
+    
+    if (method == MULTIFREQ_NUMBER_THEORETIC) {
+        if (phases[0].depth() == CV_32F)
+            crtUnwrap<float>(phases, periods, K, Phi, ws, tiles);
+        else
+            crtUnwrap<double>(phases, periods, K, Phi, ws, tiles);
+        return;
+    }
+    
+    const UnwrapChain chain = buildUnwrapChain(periods, K, method, func);
+    if (phases[0].depth() == CV_32F)
+        chainUnwrap<float>(phases, chain, Phi, ws, tiles);
+    else
+        chainUnwrap<double>(phases, chain, Phi, ws, tiles);
+}
+
+// Estimate the wrapped phase map of each frequency and unwrap them
+static void multiFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi, const int* periods,
+                                 const int* steps, int K, MultiFreqMethod method, int dtype, Workspace* ws,
+                                 cv::InputArray mask, const char* func) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images, frames, func);
+    
+    detail::checkFrequencies(periods, steps, K, frames.size(), func);
+    detail::checkFloatDepth(dtype, func);
+    const detail::TileMask tiles(mask, frames[0].size(), ws, func);
+    
+    // Estimating wrapped phase map for each frequency, in a (K*h, w) stack
+    const int h = frames[0].rows, w = frames[0].cols;
+    cv::Mat stack = detail::getBuffer(ws, detail::WS_PHASE_STACK, {w, K*h}, dtype);
+    cv::Mat phases[detail::MAX_FREQUENCIES];
+    for (int i = 0, offset = 0; i < K; offset += steps[i], i++) {
+        phases[i] = stack.rowRange(i*h, (i+1)*h);
+        detail::nStepPhaseShifting(&frames[offset], steps[i], steps[i], phases[i], cv::noArray(), dtype, tiles);
     }
     
-    // Backward phase unwrapping
-    backwardUnwrap(Phi123, phi23, T123, T23); // Estimate unwrapped version of phi23
-    backwardUnwrap(phi23, phi12, T23, T12); // Estimate unwrapped version of phi12
-    backwardUnwrap(phi12, phi3, T12, T3); // Estimate unwrapped version of phi3
-    backwardUnwrap(phi3, phi2, T3, T2); // Estimate unwrapped version of phi2
-    backwardUnwrap(phi2, phi1, T2, T1); // Estimate unwrapped version of phi1
+    detail::multiFreqUnwrap(phases, periods, K, method, _Phi, ws, tiles, func);
+    tiles.clearOutside(_Phi);
+}
+
+// Accumulate the fringe images of each frequency as they are decoded, and unwrap them with the accumulator
+// overloads. Only the frames being decoded are held in memory
+void threeFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype, cv::InputArray mask) {
+    detail::checkFrequencies(p.val, N.val, 3, impaths.size(), "threeFreqPhaseUnwrap");
+    detail::checkFloatDepth(dtype, "threeFreqPhaseUnwrap");
+    
+    detail::FrameLoader loader(impaths);
+    PhaseShiftAccumulator ps1(N[0], dtype), ps2(N[1], dtype), ps3(N[2], dtype);
+    detail::pushImages(loader, ps1, N[0]);
+    detail::pushImages(loader, ps2, N[1]);
+    detail::pushImages(loader, ps3, N[2]);
     
-    _Phi.assign(phi1);
+    threeFreqPhaseUnwrap(ps1, ps2, ps3, _Phi, p, nullptr, mask);
+}
+
+void threeFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype, Workspace* ws, cv::InputArray mask) {
+    multiFreqPhaseUnwrap(images, _Phi, p.val, N.val, 3, MULTIFREQ_HETERODYNE, dtype, ws, mask, "threeFreqPhaseUnwrap");
 }
 
 void twoFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
-                        const cv::Vec3i& p, const cv::Vec3i& N) {
-    if (impaths.size() != (N[0]+N[1]))
-        throw std::runtime_error("twoFreqPhaseUnwrap: number of image paths and number of patterns N must match");
-    
-    // Get input fringe periods
-    double T1 = p[0], T2 = p[1];
-    // Estimate equivalent period
-    double T12 = T1*T2/std::abs(T1-T2);
-    
-    // Estimating wrapped phase map for each frequency
-    cv::Mat phi1, phi2;
-    NStepPhaseShifting({impaths.begin(), impaths.begin()+N[0]}, phi1, N[0]);
-    NStepPhaseShifting({impaths.begin()+N[0], impaths.end()}, phi2, N[1]);
-    
-    // Estimate equivalent phase map
-    cv::Mat Phi12 = equivalentPhase(phi1, phi2); // Phi12 is a phase map without discontinuities
-    
-    // Remove spiky noise in the equivalent phase of wider pitch
-    cv::Mat Phi12m;
-    Phi12.convertTo(Phi12m, CV_32F); // cv::medianBlur needs float input Mat
-    cv::medianBlur(Phi12m, Phi12m, 5);
-    
-    double* pPhi12 = Phi12.ptr<double>();
-    float* pPhi12m = Phi12m.ptr<float>();
-    for (std::size_t i = 0; i < Phi12.total(); i++) {        
-        // Estimate phase order difference between phase and filtered phase
-        double n = (pPhi12[i] - pPhi12m[i])/2/CV_PI;
-        // Estimate 2*pi multiple to remove the spike (rounding n to nearest int)
-        // For pixels with no spikes rounded n must be 0 and no offset is applied
-        double offset = 2*CV_PI*cvRound(n);
-        
-        // Correct phase value
-        pPhi12[i] -= offset;
-    }
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype, cv::InputArray mask) {
+    detail::checkFrequencies(p.val, N.val, 2, impaths.size(), "twoFreqPhaseUnwrap");
+    detail::checkFloatDepth(dtype, "twoFreqPhaseUnwrap");
+    
+    detail::FrameLoader loader(impaths);
+    PhaseShiftAccumulator ps1(N[0], dtype), ps2(N[1], dtype);
+    detail::pushImages(loader, ps1, N[0]);
+    detail::pushImages(loader, ps2, N[1]);
+    
+    twoFreqPhaseUnwrap(ps1, ps2, _Phi, p, nullptr, mask);
+}
+
+void twoFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype, Workspace* ws, cv::InputArray mask) {
+    multiFreqPhaseUnwrap(images, _Phi, p.val, N.val, 2, MULTIFREQ_HETERODYNE, dtype, ws, mask, "twoFreqPhaseUnwrap");
+}
+
+void multiFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method, int dtype,
+                          cv::InputArray mask) {
+    multiFreqPhaseUnwrap(detail::readImages(impaths), _Phi, freqs, method, dtype, nullptr, mask);
+}
+
+void multiFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method, int dtype, Workspace* ws,
+                          cv::InputArray mask) {
+    const int K = freqs.size();
+    if (K < 2 or K > detail::MAX_FREQUENCIES)
+        throw std::runtime_error("multiFreqPhaseUnwrap: the number of frequencies must be between 2 and 8");
     
-    // Backward phase unwrapping
-    backwardUnwrap(Phi12, phi2, T12, T2); // Estimate unwrapped version of phi2
-    backwardUnwrap(phi2, phi1, T2, T1); // Estimate unwrapped version of phi1
+    int periods[detail::MAX_FREQUENCIES], steps[detail::MAX_FREQUENCIES];
+    for (int i = 0; i < K; i++) {
+        periods[i] = freqs[i][0];
+        steps[i] = freqs[i][1];
+    }
     
-    _Phi.assign(phi1);
+    multiFreqPhaseUnwrap(images, _Phi, periods, steps, K, method, dtype, ws, mask, "multiFreqPhaseUnwrap");
 }
 
 } // namespace sl
@@ -2,8 +2,15 @@
 
 #include <SLutils/fringe_analysis.hpp> // NStepPhaseShifting
 
+#include "cuda_mask.hpp" // invalidPixels, clearInvalid
+#include "frames.hpp" // getFrames, readImages, checkFloatDepth
+#include "unwrap_chain.hpp" // buildUnwrapChain, checkFrequencies
+
 #include <opencv2/core/cuda.hpp>
 
+#include <stdexcept> // std::runtime_error
+#include <string>
+
 
 namespace sl {
 
@@ -79,85 +86,112 @@ __global__ void removeSpikyNoise(cv::cuda::PtrStepSz<double> Phi) {
     Phi(i,j) -= 2*CV_PI*round( (Phi(i,j) - Phim)/2/CV_PI );
 }
 
-void threeFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
-                          const cv::Vec3i& p, const cv::Vec3i& N) {
-    if (impaths.size() != (N[0]+N[1]+N[2]))
-        throw std::runtime_error("threeFreqPhaseUnwrap: number of image paths and number of patterns N must match.");
-    
-    // Get input fringe periods
-    double T1 = p[0], T2 = p[1], T3 = p[2];
-    // Estimate equivalent intermidate periods
-    double T12 = T1*T2/std::abs(T1-T2);
-    double T23 = T2*T3/std::abs(T2-T3);
-    double T123 = T12*T3/std::abs(T12-T3);
+// Estimate the wrapped phase map of each frequency and unwrap them. The CUDA version does not use
+// the workspace
+static void multiFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi, const int* periods,
+                                 const int* steps, int K, MultiFreqMethod method, int dtype, cv::InputArray mask,
+                                 const char* func) {
+    std::vector<cv::Mat> frames;
+    detail::getFrames(images, frames, func);
+    detail::checkFrequencies(periods, steps, K, frames.size(), func);
+    detail::checkFloatDepth(dtype, func);
+    const cv::Mat invalid = detail::invalidPixels(mask, frames[0].size(), func);
+    if (method == MULTIFREQ_NUMBER_THEORETIC)
+        throw std::runtime_error(std::string(func) + ": the number-theoretic method is not available in the CUDA version");
+    
+    const detail::UnwrapChain chain = detail::buildUnwrapChain(periods, K, method, func);
     
     // ------------- Estimating wrapped phase map for each frequency
-    cv::cuda::GpuMat phi1, phi2, phi3;
-    NStepPhaseShifting({impaths.begin(), impaths.begin()+N[0]}, phi1, N[0]);
-    NStepPhaseShifting({impaths.begin()+N[0], impaths.begin()+N[0]+N[1]}, phi2, N[1]);
-    NStepPhaseShifting({impaths.end()-N[2], impaths.end()}, phi3, N[2]);
+    std::vector<cv::cuda::GpuMat> phi(K);
+    using Frames = std::vector<cv::Mat>;
+    for (int i = 0, offset = 0; i < K; offset += steps[i], i++)
+        NStepPhaseShifting(Frames(frames.begin()+offset, frames.begin()+offset+steps[i]), phi[i], steps[i]);
     
-
-    // ------------- Estimate equivalent phase maps
-    dim3 block(16, 16);
-    dim3 grid((phi1.cols + block.x - 1)/block.x, (phi1.rows + block.y - 1)/block.y);
     
-    cv::cuda::GpuMat phi12(phi1.size(), phi1.type());
-    equivalentPhase<<<grid, block>>>(phi1, phi2, phi12);
+    // ------------- Estimate the wide phase map
+    dim3 block(16, 16);
+    dim3 grid((phi[0].cols + block.x - 1)/block.x, (phi[0].rows + block.y - 1)/block.y);
     
-    cv::cuda::GpuMat phi23(phi1.size(), phi1.type());
-    equivalentPhase<<<grid, block>>>(phi2, phi3, phi23);
+    cv::cuda::GpuMat Phi(phi[0].size(), phi[0].type());
+    if (chain.wide >= 0) {
+        // Wrapped phase of the widest period in [0, 2*pi)
+        cv::cuda::GpuMat zero(phi[0].size(), phi[0].type(), cv::Scalar(0));
+        equivalentPhase<<<grid, block>>>(phi[chain.wide], zero, Phi);
+    }
+    else {
+        // Equivalent phase of all the frequencies
+        equivalentPhase<<<grid, block>>>(phi[0], phi[1], Phi);
+        for (int i = 2; i < K; i++)
+            equivalentPhase<<<grid, block>>>(Phi, phi[i], Phi);
+    }
     
-    cv::cuda::GpuMat Phi123(phi1.size(), phi1.type());
-    equivalentPhase<<<grid, block>>>(phi12, phi3, Phi123); // Phi123 is a wide phase without discontinuities
     
+    // ------------- Remove spiky noise in the phase of wider pitch
+    removeSpikyNoise<<<grid, block>>>(Phi);
     
-    // ------------- Remove spiky noise in the equivalent phase of wider pitch
-    removeSpikyNoise<<<grid, block>>>(Phi123);
-
     
     // ------------- Backward phase unwrapping
-    backwardUnwrap<<<grid, block>>>(Phi123, phi23, T123, T23); // Estimate unwrapped version of phi23
-    backwardUnwrap<<<grid, block>>>(phi23, phi12, T23, T12); // Estimate unwrapped version of phi12
-    backwardUnwrap<<<grid, block>>>(phi12, phi3, T12, T3); // Estimate unwrapped version of phi3
-    backwardUnwrap<<<grid, block>>>(phi3, phi2, T3, T2); // Estimate unwrapped version of phi2
-    backwardUnwrap<<<grid, block>>>(phi2, phi1, T2, T1); // Estimate unwrapped version of phi1
+    double prev_period = chain.wide_period;
+    for (int s = 0; s < chain.nsteps; s++) {
+        // The equivalent phases are estimated before the wrapped phases are unwrapped
+        const int i = chain.index[s];
+        cv::cuda::GpuMat phase;
+        if (i < K)
+            phase = phi[i];
+        else {
+            phase.create(phi[0].size(), phi[0].type());
+            equivalentPhase<<<grid, block>>>(phi[i-K], phi[i-K+1], phase);
+        }
+        
+        backwardUnwrap<<<grid, block>>>(Phi, phase, prev_period, chain.period[s]);
+        Phi = phase;
+        prev_period = chain.period[s];
+    }
     
-    phi1.copyTo(_Phi);
+    Phi.convertTo(_Phi, dtype);
+    detail::clearInvalid(invalid, _Phi);
+}
+
+void threeFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype, cv::InputArray mask) {
+    threeFreqPhaseUnwrap(detail::readImages(impaths), _Phi, p, N, dtype, nullptr, mask);
+}
+
+void threeFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                          const cv::Vec3i& p, const cv::Vec3i& N, int dtype, Workspace*, cv::InputArray mask) {
+    multiFreqPhaseUnwrap(images, _Phi, p.val, N.val, 3, MULTIFREQ_HETERODYNE, dtype, mask, "threeFreqPhaseUnwrap");
 }
 
 void twoFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
-                        const cv::Vec3i& p, const cv::Vec3i& N) {
-    if (impaths.size() != (N[0]+N[1]))
-        throw std::runtime_error("twoFreqPhaseUnwrap: number of image paths and number of patterns N must match.");
-    
-    // Get input fringe periods
-    double T1 = p[0], T2 = p[1];
-    // Estimate equivalent period
-    double T12 = T1*T2/std::abs(T1-T2);
-    
-    // Estimating wrapped phase map for each frequency
-    cv::cuda::GpuMat phi1, phi2;
-    NStepPhaseShifting({impaths.begin(), impaths.begin()+N[0]}, phi1, N[0]);
-    NStepPhaseShifting({impaths.begin()+N[0], impaths.end()}, phi2, N[1]);
-    
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype, cv::InputArray mask) {
+    twoFreqPhaseUnwrap(detail::readImages(impaths), _Phi, p, N, dtype, nullptr, mask);
+}
 
-    // Estimate equivalent phase map
-    dim3 block(16, 16);
-    dim3 grid((phi1.cols + block.x - 1)/block.x, (phi1.rows + block.y - 1)/block.y);
-    
-    cv::cuda::GpuMat Phi12(phi1.size(), phi1.type());
-    equivalentPhase<<<grid, block>>>(phi1, phi2, Phi12); // Phi12 is a phase map without discontinuities
-    
-    
-    // Remove spiky noise in the equivalent phase of wider pitch
-    removeSpikyNoise<<<grid, block>>>(Phi12);
-    
-    // Backward phase unwrapping
-    backwardUnwrap<<<grid, block>>>(Phi12, phi2, T12, T2); // Estimate unwrapped version of phi2
-    backwardUnwrap<<<grid, block>>>(phi2, phi1, T2, T1); // Estimate unwrapped version of phi1
+void twoFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                        const cv::Vec3i& p, const cv::Vec3i& N, int dtype, Workspace*, cv::InputArray mask) {
+    multiFreqPhaseUnwrap(images, _Phi, p.val, N.val, 2, MULTIFREQ_HETERODYNE, dtype, mask, "twoFreqPhaseUnwrap");
+}
+
+void multiFreqPhaseUnwrap(const std::vector<std::string>& impaths, cv::OutputArray _Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method, int dtype,
+                          cv::InputArray mask) {
+    multiFreqPhaseUnwrap(detail::readImages(impaths), _Phi, freqs, method, dtype, nullptr, mask);
+}
+
+void multiFreqPhaseUnwrap(cv::InputArrayOfArrays images, cv::OutputArray _Phi,
+                          const std::vector<cv::Vec2i>& freqs, MultiFreqMethod method, int dtype, Workspace*,
+                          cv::InputArray mask) {
+    const int K = freqs.size();
+    if (K < 2 or K > detail::MAX_FREQUENCIES)
+        throw std::runtime_error("multiFreqPhaseUnwrap: the number of frequencies must be between 2 and 8");
+    
+    int periods[detail::MAX_FREQUENCIES], steps[detail::MAX_FREQUENCIES];
+    for (int i = 0; i < K; i++) {
+        periods[i] = freqs[i][0];
+        steps[i] = freqs[i][1];
+    }
     
-    phi1.copyTo(_Phi);
+    multiFreqPhaseUnwrap(images, _Phi, periods, steps, K, method, dtype, mask, "multiFreqPhaseUnwrap");
 }
 
 } // namespace sl
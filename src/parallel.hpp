@@ -0,0 +1,49 @@
+#pragma once
+
+#include <SLutils/config.hpp> // getNumThreads
+
+#include <opencv2/core/utility.hpp> // cv::parallel_for_
+
+#include <algorithm> // std::min
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Split the rows [0, rows) of an image in contiguous bands and run body(r0, r1)
+for each band on the OpenCV thread pool. The number of bands is limited by
+sl::getNumThreads(), so at most that many bands are processed concurrently.
+Every pixel is computed by exactly the same code as in a serial loop, hence
+the results do not depend on the number of threads.
+--------------------------------------------------------------------------- */
+template <typename Body>
+void parallelForRows(int rows, const Body& body) {
+    // Minimum number of rows per band, to keep the scheduling overhead low
+    constexpr int MIN_BAND_ROWS = 8;
+    
+    const int nbands = std::min(getNumThreads(), rows/MIN_BAND_ROWS);
+    if (nbands <= 1) {
+        body(0, rows);
+        return;
+    }
+    
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& r) {
+        body(r.start, r.end);
+    }, nbands);
+}
+
+/* ---------------------------------------------------------------------------
+Run body(i) for each index i in [0, n) on the OpenCV thread pool, with one
+stripe per index. The lambda passed to cv::parallel_for_ only holds a
+reference to body, so its std::function wrapper is stored in place and no
+memory is allocated for it, whatever body captures.
+--------------------------------------------------------------------------- */
+template <typename Body>
+void parallelForEach(int n, const Body& body) {
+    cv::parallel_for_(cv::Range(0, n), [&body](const cv::Range& r) {
+        for (int i = r.start; i < r.end; i++)
+            body(i);
+    }, n);
+}
+
+} // namespace sl::detail
@@ -0,0 +1,146 @@
+#include <SLutils/patterns.hpp>
+
+#include "parallel.hpp" // parallelForRows
+
+#include <opencv2/core.hpp> // cv::RNG
+#include <opencv2/imgproc.hpp> // cv::GaussianBlur
+
+#include <algorithm> // std::max
+#include <cmath> // std::cos, std::pow, std::ceil
+#include <cstring> // std::memcpy
+#include <stdexcept> // std::runtime_error
+#include <string>
+
+
+namespace sl {
+
+/* ---------------------------------------------------------------------------
+The generated patterns are constant along y, so only one ideal row per
+pattern is computed. The gamma curve and the defocus blur (which reduces to a
+1D blur along x for these patterns) are applied to that row, and the rows of
+the output are then copied from it, adding noise per pixel when requested.
+--------------------------------------------------------------------------- */
+static void renderPatterns(std::vector<cv::Mat>& rows, cv::Size size, const PatternModel& model,
+                           cv::OutputArray _patterns, const char* func) {
+    if (model.gamma <= 0 or model.defocus < 0 or model.noise < 0)
+        throw std::runtime_error(std::string(func) + ": gamma must be positive and defocus and noise non-negative");
+    
+    const int n = static_cast<int>(rows.size()), h = size.height, w = size.width;
+    std::vector<cv::Mat> rows8u(n);
+    for (int k = 0; k < n; k++) {
+        cv::Mat& row = rows[k];
+        
+        if (model.gamma != 1) {
+            float* prow = row.ptr<float>();
+            for (int x = 0; x < w; x++)
+                prow[x] = static_cast<float>(255*std::pow(std::max(prow[x], 0.f)/255, model.gamma));
+        }
+        
+        if (model.defocus > 0) {
+            const int ksize = 2*static_cast<int>(std::ceil(3*model.defocus)) + 1;
+            cv::GaussianBlur(row, row, cv::Size(ksize, 1), model.defocus, 0, cv::BORDER_REPLICATE);
+        }
+        
+        row.convertTo(rows8u[k], CV_8U);
+    }
+    
+    const int dims[] = {n, h, w};
+    _patterns.create(3, dims, CV_8U);
+    cv::Mat patterns = _patterns.getMat();
+    
+    detail::parallelForRows(h, [&](int r0, int r1) {
+        cv::Mat noise(1, w, CV_32F);
+        for (int k = 0; k < n; k++) {
+            for (int y = r0; y < r1; y++) {
+                uchar* dst = patterns.ptr<uchar>(k, y);
+                if (model.noise == 0) {
+                    std::memcpy(dst, rows8u[k].ptr<uchar>(), w);
+                    continue;
+                }
+                
+                // One generator per row and pattern, so the noise does not depend on the number of threads
+                cv::RNG rng(model.seed*0x9E3779B97F4A7C15ull + static_cast<std::uint64_t>(k)*h + y + 1);
+                rng.fill(noise, cv::RNG::NORMAL, 0, model.noise);
+                
+                const float *prow = rows[k].ptr<float>(), *pnoise = noise.ptr<float>();
+                for (int x = 0; x < w; x++)
+                    dst[x] = cv::saturate_cast<uchar>(prow[x] + pnoise[x]);
+            }
+        }
+    });
+}
+
+static void checkSize(cv::Size size, const char* func) {
+    if (size.width <= 0 or size.height <= 0)
+        throw std::runtime_error(std::string(func) + ": invalid pattern size");
+}
+
+// Ideal fringe rows of one frequency, appended to rows
+static void fringeRows(double period, int N, int w, const PatternModel& model, std::vector<cv::Mat>& rows) {
+    for (int i = 0; i < N; i++) {
+        cv::Mat row(1, w, CV_32F);
+        float* prow = row.ptr<float>();
+        const double delta = 2*CV_PI*(i + 1)/N;
+        for (int x = 0; x < w; x++)
+            prow[x] = static_cast<float>(model.offset + model.amplitude*std::cos(2*CV_PI*x/period + delta));
+        
+        rows.push_back(row);
+    }
+}
+
+void generateFringes(double period, int N, cv::Size size, cv::OutputArray patterns, const PatternModel& model) {
+    checkSize(size, "generateFringes");
+    if (period <= 0 or N < 3)
+        throw std::runtime_error("generateFringes: period must be positive and N >= 3");
+    
+    std::vector<cv::Mat> rows;
+    fringeRows(period, N, size.width, model, rows);
+    renderPatterns(rows, size, model, patterns, "generateFringes");
+}
+
+void generateMultiFreqFringes(const std::vector<cv::Vec2i>& freqs, cv::Size size, cv::OutputArray patterns,
+                              const PatternModel& model) {
+    checkSize(size, "generateMultiFreqFringes");
+    if (freqs.empty())
+        throw std::runtime_error("generateMultiFreqFringes: no frequencies");
+    
+    std::vector<cv::Mat> rows;
+    for (const cv::Vec2i& freq : freqs) {
+        if (freq[0] <= 0 or freq[1] < 3)
+            throw std::runtime_error("generateMultiFreqFringes: periods must be positive and N >= 3");
+        fringeRows(freq[0], freq[1], size.width, model, rows);
+    }
+    
+    renderPatterns(rows, size, model, patterns, "generateMultiFreqFringes");
+}
+
+void generateGrayCode(int nbits, cv::Size size, bool inverted, cv::OutputArray patterns, int period,
+                      const PatternModel& model) {
+    checkSize(size, "generateGrayCode");
+    if (nbits < 1 or nbits > 31 or period < 0)
+        throw std::runtime_error("generateGrayCode: nbits must be in [1, 31] and period non-negative");
+    
+    // Narrowest stripes that cover the width with 2^nbits stripes
+    if (period == 0)
+        period = static_cast<int>((size.width + (1ll << nbits) - 1) >> nbits);
+    
+    std::vector<cv::Mat> rows;
+    for (int k = 0; k < nbits; k++) {
+        cv::Mat row(1, size.width, CV_32F), row_inv(1, size.width, CV_32F);
+        float *prow = row.ptr<float>(), *prow_inv = row_inv.ptr<float>();
+        for (int x = 0; x < size.width; x++) {
+            const unsigned stripe = x/period, gray = stripe ^ (stripe >> 1);
+            const double sign = (gray >> (nbits - k - 1)) & 1 ? 1 : -1;
+            prow[x] = static_cast<float>(model.offset + sign*model.amplitude);
+            prow_inv[x] = static_cast<float>(model.offset - sign*model.amplitude);
+        }
+        
+        rows.push_back(row);
+        if (inverted)
+            rows.push_back(row_inv);
+    }
+    
+    renderPatterns(rows, size, model, patterns, "generateGrayCode");
+}
+
+} // namespace sl
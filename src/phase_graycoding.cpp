@@ -1,53 +1,234 @@
 #include <SLutils/phase_graycoding.hpp>
+#include <SLutils/streaming.hpp> // PhaseShiftAccumulator, GrayCodeAccumulator
 
-#include <SLutils/fringe_analysis.hpp> // NStepPhaseShifting
-#include <SLutils/graycoding.hpp> // decimalMap
+#include "buffers.hpp" // getBuffer, getFrameList
+#include "fast_math.hpp" // detail::rewrap
+#include "frames.hpp" // getFrames, readImages, FrameLoader, checkFloatDepth
+#include "graycode.hpp" // decimalMap
+#include "parallel.hpp" // parallelForRows, parallelForEach
+#include "phase_shifting.hpp" // nStepPhaseShifting
+#include "spiky_noise.hpp" // removeSpikyNoise
+#include "stats.hpp" // StageTimer
+#include "tile_mask.hpp"
+#include "unwrap.hpp"
 
 #include <cmath>
+#include <stdexcept> // std::runtime_error
+
+template <typename T>
+static void rewrapPhase(cv::Mat& phi, double shift) {
+    sl::detail::parallelForRows(phi.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++)
+            sl::detail::rewrap(phi.ptr<T>(i), phi.cols, static_cast<T>(shift));
+    });
+}
+
+// Phi -= shift, without the block buffer that cv::subtract allocates for a scalar operand
+template <typename T>
+static void subtractShift(cv::Mat& Phi, double shift) {
+    sl::detail::parallelForRows(Phi.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            T* pPhi = Phi.ptr<T>(i);
+            for (int j = 0; j < Phi.cols; j++)
+                pPhi[j] -= static_cast<T>(shift);
+        }
+    });
+}
 
 void sl::phaseGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
                                const std::vector<std::string>& impaths_gc,
-                               cv::OutputArray _Phi, int p, int N) {
-    // Estimate wrapped phase map
-    cv::Mat phi;
-    NStepPhaseShifting(impaths_ps, phi, N);
+                               cv::OutputArray _Phi, int p, int N, int dtype, cv::InputArray mask) {
+    const int n_ps = static_cast<int>(impaths_ps.size()), n_gc = static_cast<int>(impaths_gc.size());
+    if (N < 3 or n_ps != N or n_gc == 0 or n_gc % 2 != 0 or n_gc/2 > 31) {
+        auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+        phaseGraycodingUnwrap(images_ps, images_gc, _Phi, p, N, dtype, nullptr, mask);
+        return;
+    }
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrap");
     
-    // Estimate decimal map (phase order) with the gray patterns
-    cv::Mat k;
-    decimalMap(impaths_gc, k);
-    k.convertTo(k, CV_64F); // convert to double
+    // Accumulate the fringe images and then the graycode pairs as they are decoded
+    std::vector<std::string> impaths(impaths_ps);
+    impaths.insert(impaths.end(), impaths_gc.begin(), impaths_gc.end());
+    detail::FrameLoader loader(impaths);
+    PhaseShiftAccumulator ps(N, dtype);
+    GrayCodeAccumulator gc(n_gc/2);
+    detail::pushImages(loader, ps, n_ps);
+    detail::pushImages(loader, gc, n_gc);
+    
+    phaseGraycodingUnwrap(ps, gc, _Phi, p, nullptr, mask);
+}
+
+// Unwrap the rectangle r of phi with the phase order map k
+static void graycodeUnwrapRect(cv::Mat phi, const cv::Mat& k, cv::Mat& kf, cv::Mat Phi, int p) {
+    // Convert the phase order map to the precision of the phase
+    k.convertTo(kf, phi.type());
 
     // Shift and rewrap wrapped phase
     double shift = -CV_PI + CV_PI/p;
-    double* phid = phi.ptr<double>();
-    for (std::size_t i = 0; i < phi.total(); i++) {
-        double phi_shift = phid[i] + shift; // shifted phase value
-        phid[i] = std::atan2(std::sin(phi_shift), std::cos(phi_shift));
-    }
+    if (phi.depth() == CV_32F)
+        rewrapPhase<float>(phi, shift);
+    else
+        rewrapPhase<double>(phi, shift);
 
     // Estimate absolute phase map
+    Phi = phi + 2*CV_PI*kf;
+
+    // Shift phase back to the original values
+    if (Phi.depth() == CV_32F)
+        subtractShift<float>(Phi, shift);
+    else
+        subtractShift<double>(Phi, shift);
+}
+
+void sl::detail::graycodeUnwrap(cv::Mat& phi, const cv::Mat& k, cv::OutputArray _Phi, int p, Workspace* ws,
+                                const TileMask& tiles) {
     _Phi.create(phi.size(), phi.type());
     cv::Mat Phi = _Phi.getMat();
-    Phi = phi + 2*CV_PI*k;
 
-    // Shift phase back to the original values
-    Phi -= shift;
+    {
+        StageTimer timer(STATS_UNWRAP, phi.total()*(4*phi.elemSize() + k.elemSize()));
+        cv::Mat kf = getBuffer(ws, WS_ORDER_PHASE, k.size(), phi.type());
+
+        // With a mask, the rectangles of the runs are unwrapped concurrently
+        if (!tiles.hasMask())
+            graycodeUnwrapRect(phi, k, kf, Phi, p);
+        else {
+            parallelForEach(tiles.numRuns(), [&](int r) {
+                const cv::Rect rect = tiles.runRect(r);
+                cv::Mat kf_rect = kf(rect);
+                graycodeUnwrapRect(phi(rect), k(rect), kf_rect, Phi(rect), p);
+            });
+        }
+    }
 
     // Filter spiky noise
-    cv::Mat Phim;
-    Phi.convertTo(Phim, CV_32F); // cv::medianBlur needs float input Mat
-    cv::medianBlur(Phim, Phim, 5);
-
-    double* pPhi = Phi.ptr<double>();
-    float* pPhim = Phim.ptr<float>();
-    for (std::size_t i = 0; i < Phi.total(); i++) {        
-        // Estimate phase order difference between phase and filtered phase
-        double n = (pPhi[i] - pPhim[i])/2/CV_PI;
-        // Estimate 2*pi multiple to remove the spike (rounding n to nearest int)
-        // For pixels with no spikes rounded n must be 0 and no offset is applied
-        double offset = 2*CV_PI*cvRound(n);
-        
-        // Correct phase value
-        pPhi[i] -= offset;
+    removeSpikyNoise(Phi, ws, tiles);
+}
+
+void sl::phaseGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                               cv::OutputArray _Phi, int p, int N, int dtype, Workspace* ws,
+                               cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images_ps, frames, "phaseGraycodingUnwrap");
+    if (frames.size() < 3)
+        throw std::runtime_error("phaseGraycodingUnwrap needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrap");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "phaseGraycodingUnwrap");
+    
+    // Estimate wrapped phase map
+    cv::Mat local_phi;
+    cv::Mat& phi = ws ? ws->buffer(detail::WS_PHASE1) : local_phi;
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, phi, cv::noArray(), dtype, tiles);
+    
+    // Estimate decimal map (phase order) with the gray patterns
+    cv::Mat local_k;
+    cv::Mat& k = ws ? ws->buffer(detail::WS_ORDER) : local_k;
+    detail::decimalMap(images_gc, k, ws, tiles, "phaseGraycodingUnwrap");
+
+    // Unwrap phase with the phase order map
+    detail::graycodeUnwrap(phi, k, _Phi, p, ws, tiles);
+    tiles.clearOutside(_Phi);
+}
+
+void sl::phaseGraycodingUnwrap_valid(const std::vector<std::string>& impaths_ps,
+                                     const std::vector<std::string>& impaths_gc,
+                                     cv::OutputArray _Phi, cv::OutputArray _valid, int p, int N,
+                                     const ValidityCriteria& criteria, int dtype, cv::InputArray mask) {
+    auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+    phaseGraycodingUnwrap_valid(images_ps, images_gc, _Phi, _valid, p, N, criteria, dtype, nullptr, mask);
+}
+
+void sl::phaseGraycodingUnwrap_valid(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                     cv::OutputArray _Phi, cv::OutputArray _valid, int p, int N,
+                                     const ValidityCriteria& criteria, int dtype, Workspace* ws,
+                                     cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images_ps, frames, "phaseGraycodingUnwrap_valid");
+    if (frames.size() < 3)
+        throw std::runtime_error("phaseGraycodingUnwrap_valid needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrap_valid");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "phaseGraycodingUnwrap_valid");
+    detail::ValidityPass validity = detail::validityPass(criteria, _valid, frames[0].size(), ws,
+                                                         "phaseGraycodingUnwrap_valid");
+    
+    // Estimate wrapped phase map and validity mask
+    cv::Mat local_phi;
+    cv::Mat& phi = ws ? ws->buffer(detail::WS_PHASE1) : local_phi;
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, phi, cv::noArray(), dtype, tiles, &validity);
+    
+    // Tiles of the valid pixels, from the column extents recorded in the phase pass
+    const detail::TileMask valid_tiles(validity.valid, validity.extents, ws);
+    
+    // Estimate decimal map (phase order) with the gray patterns
+    cv::Mat local_k;
+    cv::Mat& k = ws ? ws->buffer(detail::WS_ORDER) : local_k;
+    detail::decimalMap(images_gc, k, ws, valid_tiles, "phaseGraycodingUnwrap_valid");
+
+    // Unwrap phase with the phase order map
+    detail::graycodeUnwrap(phi, k, _Phi, p, ws, valid_tiles);
+    valid_tiles.clearOutside(_Phi);
+}
+
+// Unwrap phi in place with the decimal map V of the complementary graycode, at the runs of occupied tiles
+template <typename T>
+static void complementaryUnwrap(cv::Mat& phi, const cv::Mat& V, const sl::detail::TileMask& tiles) {
+    const T twoPI = static_cast<T>(2*CV_PI), halfPI = static_cast<T>(CV_PI/2), threeHalfPI = static_cast<T>(3*CV_PI/2);
+    
+    sl::detail::parallelForRows(phi.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            T* pphi = phi.ptr<T>(i);
+            const int* pV = V.ptr<int>(i);
+            tiles.forEachRun(i, [&](int j0, int j1) {
+                for (int j = j0; j < j1; j++) {
+                    // Wrapped phase in [0, 2*pi)
+                    const T p = pphi[j] < 0 ? pphi[j] + twoPI : pphi[j];
+                    
+                    // Fringe orders of the first n codes and of all the codes
+                    const int k1 = pV[j] >> 1, k2 = (pV[j] + 1) >> 1;
+                    const int k = p < halfPI ? k2 : (p > threeHalfPI ? k2 - 1 : k1);
+                    
+                    pphi[j] = p + twoPI*k;
+                }
+            });
+        }
+    });
+}
+
+void sl::complementaryGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
+                                       const std::vector<std::string>& impaths_gc,
+                                       cv::OutputArray _Phi, int N, int dtype, cv::InputArray mask) {
+    auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+    complementaryGraycodingUnwrap(images_ps, images_gc, _Phi, N, dtype, nullptr, mask);
+}
+
+void sl::complementaryGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                       cv::OutputArray _Phi, int N, int dtype, Workspace* ws, cv::InputArray mask) {
+    std::vector<cv::Mat> local_frames;
+    std::vector<cv::Mat>& frames = detail::getFrameList(ws, local_frames);
+    detail::getFrames(images_ps, frames, "complementaryGraycodingUnwrap");
+    if (frames.size() < 3)
+        throw std::runtime_error("complementaryGraycodingUnwrap needs at least 3 fringe patterns");
+    detail::checkFloatDepth(dtype, "complementaryGraycodingUnwrap");
+    const detail::TileMask tiles(mask, frames[0].size(), ws, "complementaryGraycodingUnwrap");
+    
+    // Estimate wrapped phase map, directly in the output array
+    detail::nStepPhaseShifting(frames.data(), frames.size(), N, _Phi, cv::noArray(), dtype, tiles);
+    cv::Mat Phi = _Phi.getMat();
+    
+    // Estimate decimal map of the complementary graycode
+    cv::Mat local_V;
+    cv::Mat& V = ws ? ws->buffer(detail::WS_ORDER) : local_V;
+    detail::decimalMap(images_gc, V, ws, tiles, "complementaryGraycodingUnwrap");
+    
+    // Unwrap phase pixel by pixel
+    {
+        detail::StageTimer timer(STATS_UNWRAP, Phi.total()*(2*Phi.elemSize() + V.elemSize()));
+        if (Phi.depth() == CV_32F)
+            complementaryUnwrap<float>(Phi, V, tiles);
+        else
+            complementaryUnwrap<double>(Phi, V, tiles);
     }
+    tiles.clearOutside(_Phi);
 }
@@ -1,9 +1,13 @@
 #include <SLutils/phase_graycoding.hpp>
 
-#include <SLutils/fringe_analysis.hpp> // NStepPhaseShifting
+#include <SLutils/fringe_analysis.hpp> // NStepPhaseShifting, NStepPhaseShifting_valid
 #include <SLutils/graycoding.hpp> // decimalMap
 
+#include "cuda_mask.hpp" // invalidPixels, clearInvalid
+#include "frames.hpp" // readImages, checkFloatDepth
+
 #include <opencv2/core/cuda.hpp>
+#include <opencv2/cudaarithm.hpp> // cv::cuda::compare
 
 
 namespace sl {
@@ -63,31 +67,134 @@ __global__ void removeSpikyNoise(cv::cuda::PtrStepSz<double> Phi) {
     Phi(i,j) -= 2*CV_PI*round( (Phi(i,j) - Phim)/2/CV_PI );
 }
 
+__global__ void unwrapComplementary(const cv::cuda::PtrStepSz<double> phi, const cv::cuda::PtrStepi V,
+                                    cv::cuda::PtrStep<double> Phi) {
+    int j = blockIdx.x*blockDim.x + threadIdx.x;
+    int i = blockIdx.y*blockDim.y + threadIdx.y;
+    if (i >= phi.rows || j >= phi.cols) return;
+
+    // Wrapped phase in [0, 2*pi)
+    double p = phi(i,j) < 0 ? phi(i,j) + 2*CV_PI : phi(i,j);
+
+    // Fringe orders of the first n codes and of all the codes
+    int k1 = V(i,j) >> 1, k2 = (V(i,j) + 1) >> 1;
+    int k = p < CV_PI/2 ? k2 : (p > 3*CV_PI/2 ? k2 - 1 : k1);
+
+    Phi(i,j) = p + 2*CV_PI*k;
+}
+
 void phaseGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
                            const std::vector<std::string>& impaths_gc,
-                           cv::OutputArray _Phi, int p, int N) {
-    // Estimate wrapped phase map
-    cv::cuda::GpuMat phi; // double mat
-    NStepPhaseShifting(impaths_ps, phi, N);
-    
+                           cv::OutputArray _Phi, int p, int N, int dtype, cv::InputArray mask) {
+    auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+    phaseGraycodingUnwrap(images_ps, images_gc, _Phi, p, N, dtype, nullptr, mask);
+}
+
+// Unwrap the wrapped phase map phi (CV_64F) with the phase order map of the gray patterns, and
+// remove spiky noise
+static void graycodeUnwrap(const cv::cuda::GpuMat& phi, cv::InputArrayOfArrays images_gc, cv::OutputArray _Phi,
+                           int p, int dtype) {
     // Estimate decimal map (phase order) with the gray patterns
     cv::cuda::GpuMat k;
-    decimalMap(impaths_gc, k);
+    decimalMap(images_gc, k);
 
 
     // --- Phase unwrapping using the phase order map k
     dim3 block(16, 16);
     dim3 grid((phi.cols + block.x - 1)/block.x, (phi.rows + block.y - 1)/block.y);
     double shift = -CV_PI + CV_PI/p;
-    // Get output array
-    _Phi.create(phi.size(), phi.type());
-    cv::cuda::GpuMat Phi = _Phi.getGpuMat();
+    // Get output array (the kernels compute in double and the result is converted to dtype)
+    cv::cuda::GpuMat Phi;
+    if (dtype == CV_64F) {
+        _Phi.create(phi.size(), phi.type());
+        Phi = _Phi.getGpuMat();
+    }
+    else
+        Phi.create(phi.size(), phi.type());
     // Launch kernel
     unwrapWithPhaseOrder<<<grid, block>>>(phi, k, Phi, shift);
 
 
     // --- Remove spiky noise using median filter
     removeSpikyNoise<<<grid, block>>>(Phi);
+    
+    if (dtype != CV_64F)
+        Phi.convertTo(_Phi, dtype);
+}
+
+// The CUDA version does not use the workspace
+void phaseGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                           cv::OutputArray _Phi, int p, int N, int dtype, Workspace*, cv::InputArray mask) {
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrap");
+    
+    // Estimate wrapped phase map
+    cv::cuda::GpuMat phi; // double mat
+    NStepPhaseShifting(images_ps, phi, N);
+    
+    graycodeUnwrap(phi, images_gc, _Phi, p, dtype);
+    detail::clearInvalid(detail::invalidPixels(mask, phi.size(), "phaseGraycodingUnwrap"), _Phi);
+}
+
+void complementaryGraycodingUnwrap(const std::vector<std::string>& impaths_ps,
+                                   const std::vector<std::string>& impaths_gc,
+                                   cv::OutputArray _Phi, int N, int dtype, cv::InputArray mask) {
+    auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+    complementaryGraycodingUnwrap(images_ps, images_gc, _Phi, N, dtype, nullptr, mask);
+}
+
+// The CUDA version does not use the workspace
+void complementaryGraycodingUnwrap(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                   cv::OutputArray _Phi, int N, int dtype, Workspace*, cv::InputArray mask) {
+    detail::checkFloatDepth(dtype, "complementaryGraycodingUnwrap");
+    
+    // Estimate wrapped phase map and decimal map of the complementary graycode
+    cv::cuda::GpuMat phi; // double mat
+    NStepPhaseShifting(images_ps, phi, N);
+    cv::cuda::GpuMat V;
+    decimalMap(images_gc, V);
+    
+    // Unwrap phase pixel by pixel, in place
+    dim3 block(16, 16);
+    dim3 grid((phi.cols + block.x - 1)/block.x, (phi.rows + block.y - 1)/block.y);
+    unwrapComplementary<<<grid, block>>>(phi, V, phi);
+    
+    if (dtype == CV_64F)
+        phi.copyTo(_Phi);
+    else
+        phi.convertTo(_Phi, dtype);
+    detail::clearInvalid(detail::invalidPixels(mask, phi.size(), "complementaryGraycodingUnwrap"), _Phi);
+}
+
+void phaseGraycodingUnwrap_valid(const std::vector<std::string>& impaths_ps,
+                                 const std::vector<std::string>& impaths_gc,
+                                 cv::OutputArray _Phi, cv::OutputArray _valid, int p, int N,
+                                 const ValidityCriteria& criteria, int dtype, cv::InputArray mask) {
+    auto [images_ps, images_gc] = detail::readImages(impaths_ps, impaths_gc);
+    phaseGraycodingUnwrap_valid(images_ps, images_gc, _Phi, _valid, p, N, criteria, dtype, nullptr, mask);
+}
+
+// The CUDA version computes all the pixels and sets Phi to 0 at the invalid ones
+void phaseGraycodingUnwrap_valid(cv::InputArrayOfArrays images_ps, cv::InputArrayOfArrays images_gc,
+                                 cv::OutputArray _Phi, cv::OutputArray _valid, int p, int N,
+                                 const ValidityCriteria& criteria, int dtype, Workspace*, cv::InputArray mask) {
+    detail::checkFloatDepth(dtype, "phaseGraycodingUnwrap_valid");
+    
+    // Estimate wrapped phase map and validity mask
+    cv::cuda::GpuMat phi, valid; // double mat, CV_8U mat
+    if (_valid.needed()) {
+        NStepPhaseShifting_valid(images_ps, phi, _valid, N, criteria, CV_64F, nullptr, mask);
+        valid = _valid.getGpuMat();
+    }
+    else
+        NStepPhaseShifting_valid(images_ps, phi, valid, N, criteria, CV_64F, nullptr, mask);
+    
+    graycodeUnwrap(phi, images_gc, _Phi, p, dtype);
+    
+    // Set Phi to 0 at the invalid pixels
+    cv::cuda::GpuMat invalid;
+    cv::cuda::compare(valid, cv::Scalar::all(0), invalid, cv::CMP_EQ);
+    cv::cuda::GpuMat Phi = _Phi.getGpuMat();
+    Phi.setTo(cv::Scalar::all(0), invalid);
 }
 
 } // namespace sl
@@ -0,0 +1,46 @@
+#include "phase_lut.hpp"
+
+#include <cmath> // std::atan2, std::sqrt
+
+
+namespace sl::detail {
+
+template <typename T>
+static PhaseLUT<T> buildPhaseLUT(int amax, int bmax, T s) {
+    PhaseLUT<T> lut;
+    lut.amax = amax;
+    lut.bmax = bmax;
+    
+    const std::size_t size = static_cast<std::size_t>(2*amax + 1)*(2*bmax + 1);
+    lut.phase.resize(size);
+    lut.magnitude.resize(size);
+    
+    for (int a = -amax; a <= amax; a++) {
+        for (int b = -bmax; b <= bmax; b++) {
+            const T num = s*static_cast<T>(a), den = static_cast<T>(b);
+            lut.phase[lut.index(a, b)] = std::atan2(num, den);
+            lut.magnitude[lut.index(a, b)] = std::sqrt(num*num + den*den);
+        }
+    }
+    
+    return lut;
+}
+
+template <typename T>
+const PhaseLUT<T>& threeStepLUT() {
+    static const PhaseLUT<T> lut = buildPhaseLUT<T>(255, 510, std::sqrt(T(3)));
+    return lut;
+}
+
+template <typename T>
+const PhaseLUT<T>& fourStepLUT() {
+    static const PhaseLUT<T> lut = buildPhaseLUT<T>(255, 255, T(1));
+    return lut;
+}
+
+template const PhaseLUT<float>& threeStepLUT<float>();
+template const PhaseLUT<double>& threeStepLUT<double>();
+template const PhaseLUT<float>& fourStepLUT<float>();
+template const PhaseLUT<double>& fourStepLUT<double>();
+
+} // namespace sl::detail
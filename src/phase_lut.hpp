@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Lookup tables of the wrapped phase atan2(s*a, b) and of the magnitude
+sqrt((s*a)^2 + b^2) for the integer numerators a in [-amax, amax] and
+denominators b in [-bmax, bmax] of the three- and four-step algorithms with
+8-bit images. The values are computed in precision T with the same
+expressions as the exact kernels. Each table is built on first use and then
+shared by all the calls and threads of the process.
+--------------------------------------------------------------------------- */
+template <typename T>
+struct PhaseLUT {
+    int amax, bmax;
+    std::vector<T> phase, magnitude;
+    
+    int index(int a, int b) const { return (a + amax)*(2*bmax + 1) + b + bmax; }
+};
+
+// s = sqrt(3), a in [-255, 255] and b in [-510, 510]
+template <typename T>
+const PhaseLUT<T>& threeStepLUT();
+
+// s = 1, a and b in [-255, 255]
+template <typename T>
+const PhaseLUT<T>& fourStepLUT();
+
+} // namespace sl::detail
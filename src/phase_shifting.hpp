@@ -0,0 +1,35 @@
+#pragma once
+
+#include <SLutils/fringe_analysis.hpp> // ValidityCriteria
+#include <SLutils/workspace.hpp>
+
+#include "tile_mask.hpp"
+
+#include <opencv2/core/mat.hpp>
+
+
+namespace sl::detail {
+
+// Validity mask written by the phase pass. A pixel is valid (255) if it is in the input mask, its
+// data modulation is at least min_modulation and all its intensities are below saturation. The
+// column extents of the valid pixels of each row and tile (see maskRowExtents) are recorded too
+struct ValidityPass {
+    double min_modulation;
+    int saturation;
+    cv::Mat valid; // CV_8U
+    cv::Mat extents; // (h, rowTiles(w)) CV_32SC2
+};
+
+// Validity pass of the given criteria writing into the valid output array, or into a workspace buffer
+// when it is not needed. The column extents are kept in a workspace buffer
+ValidityPass validityPass(const ValidityCriteria& criteria, cv::OutputArray valid, cv::Size size, Workspace* ws,
+                          const char* func);
+
+// N-step phase-shifting of n >= 3 validated fringe images (8-bit, single-channel, same size). The
+// data modulation is only estimated when requested, and only the runs of occupied tiles are computed.
+// The validity mask is also computed when validity is not null, with its arrays (re)created here
+void nStepPhaseShifting(const cv::Mat* frames, int n, int N, cv::OutputArray phase,
+                        cv::OutputArray data_modulation, int dtype, const TileMask& tiles,
+                        ValidityPass* validity = nullptr);
+
+} // namespace sl::detail
@@ -0,0 +1,188 @@
+#include "spiky_noise.hpp"
+#include <SLutils/config.hpp> // getNumThreads
+
+#include "buffers.hpp" // getBuffer
+#include "parallel.hpp" // parallelForEach
+#include "stats.hpp" // StageTimer, recordSpikeCorrections, recordSpikeCandidates
+
+#include <algorithm> // std::min, std::max, std::clamp, std::copy, std::nth_element
+#include <cstdint> // std::uint64_t
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Selective spike removal. A pixel is corrected by k = round((Phi - Phim)/2pi)
+periods, where Phim is the 5x5 median of its neighborhood. The median lies
+between the minimum and the maximum of the neighborhood, so when they are
+less than pi apart k is 0 and the median is not needed. Fringe order spikes
+only occur near the code transitions, so the range of the neighborhoods (a
+separable 5x5 min/max filter) is computed for all the pixels, and the median
+only for the candidates whose range is at least SPIKE_RANGE. The margin below
+pi covers the rounding of the single-precision median, which is the same as
+the one of cv::medianBlur: same float values and replicated borders.
+--------------------------------------------------------------------------- */
+constexpr double SPIKE_RANGE = 0.9*CV_PI;
+
+// Call candidate(x) for each spike candidate among the columns [x0, x1) of a row of width w, where rows[d] is
+// the row d - 2 rows away from it (clamped to the image by the caller) and the columns are clamped to [0, w).
+// cmin and cmax have room for min(x1 - x0 + 4, w) values. candidate may change the row pointers
+template <typename T, typename Candidate>
+static void forEachCandidate(const T* const* rows, int w, int x0, int x1, T* cmin, T* cmax,
+                             const Candidate& candidate) {
+    const int c0 = std::max(x0 - 2, 0), c1 = std::min(x1 + 2, w);
+    
+    // Minimum and maximum of the 5 rows of each column
+    for (int x = c0; x < c1; x++) {
+        T lo = rows[0][x], hi = rows[0][x];
+        for (int d = 1; d < 5; d++) {
+            lo = std::min(lo, rows[d][x]);
+            hi = std::max(hi, rows[d][x]);
+        }
+        cmin[x - c0] = lo;
+        cmax[x - c0] = hi;
+    }
+    
+    // Range of the 5 columns around each pixel
+    const T threshold = static_cast<T>(SPIKE_RANGE);
+    for (int x = x0; x < x1; x++) {
+        const int a = std::max(x - 2, c0) - c0, b = std::min(x + 3, c1) - c0;
+        T lo = cmin[a], hi = cmax[a];
+        for (int c = a + 1; c < b; c++) {
+            lo = std::min(lo, cmin[c]);
+            hi = std::max(hi, cmax[c]);
+        }
+        if (hi - lo >= threshold)
+            candidate(x);
+    }
+}
+
+// 5x5 median at column x of the rows of forEachCandidate, with replicated borders. Since the conversion to
+// float is monotonic, the median of a CV_64F map converted to float is the median of its CV_32F version
+template <typename T>
+static float median5x5(const T* const* rows, int w, int x) {
+    T v[25];
+    int m = 0;
+    for (int d = 0; d < 5; d++) {
+        for (int dx = -2; dx <= 2; dx++)
+            v[m++] = rows[d][std::clamp(x + dx, 0, w - 1)];
+    }
+    
+    std::nth_element(v, v + 12, v + 25);
+    return static_cast<float>(v[12]);
+}
+
+/* ---------------------------------------------------------------------------
+The medians must see the uncorrected map, so the rows are corrected in place
+but their reads come from uncorrected copies: the two rows above and below
+each band are copied before the bands run, and, within a band, a row is
+copied in a ring of three rows before its first correction. The medians of
+the next two rows read the copy, and rows without spikes are not copied.
+--------------------------------------------------------------------------- */
+template <typename T>
+static void removeSpikyNoise_(cv::Mat& Phi, Workspace* ws, const TileMask& tiles) {
+    // Rows of the buffer of each band: column minima and maxima, ring of row copies and rows around the band
+    constexpr int MIN_BAND_ROWS = 8;
+    constexpr int BAND_ROWS = 9, RING = 2, AROUND = 5;
+    
+    const int h = Phi.rows, w = Phi.cols;
+    const int nbands = std::max(1, std::min(getNumThreads(), h/MIN_BAND_ROWS));
+    cv::Mat buf = getBuffer(ws, WS_SPIKE_ROWS, {w, nbands*BAND_ROWS}, Phi.type());
+    
+    for (int b = 0; b < nbands; b++) {
+        const int r0 = b*h/nbands, r1 = (b + 1)*h/nbands;
+        const int around[4] = {r0 - 2, r0 - 1, r1, r1 + 1};
+        for (int s = 0; s < 4; s++) {
+            if (around[s] >= 0 and around[s] < h)
+                std::copy(Phi.ptr<T>(around[s]), Phi.ptr<T>(around[s]) + w, buf.ptr<T>(b*BAND_ROWS + AROUND + s));
+        }
+    }
+    
+    detail::parallelForEach(nbands, [&](int b) {
+        const int r0 = b*h/nbands, r1 = (b + 1)*h/nbands;
+        T *cmin = buf.ptr<T>(b*BAND_ROWS), *cmax = buf.ptr<T>(b*BAND_ROWS + 1);
+        
+        // Uncorrected rows y of the band, with y < i, indexed by y % 3
+        const T* ring[3];
+        std::uint64_t candidates = 0, corrections = 0;
+        for (int i = r0; i < r1; i++) {
+            T* pPhi = Phi.ptr<T>(i);
+            ring[i % 3] = pPhi;
+            
+            const T* rows[5];
+            for (int d = 0; d < 5; d++) {
+                const int y = std::clamp(i + d - 2, 0, h - 1);
+                if (y < r0)
+                    rows[d] = buf.ptr<T>(b*BAND_ROWS + AROUND + y - (r0 - 2));
+                else if (y >= r1)
+                    rows[d] = buf.ptr<T>(b*BAND_ROWS + AROUND + 2 + y - r1);
+                else
+                    rows[d] = y <= i ? ring[y % 3] : Phi.ptr<T>(y);
+            }
+            
+            tiles.forEachRun(i, [&](int j0, int j1) {
+                forEachCandidate<T>(rows, w, j0, j1, cmin, cmax, [&](int j) {
+                    const float Phim = median5x5<T>(rows, w, j);
+                    if constexpr (STATS_ENABLED)
+                        candidates++;
+                    
+                    // Estimate phase order difference between phase and filtered phase
+                    T n = (pPhi[j] - Phim)/2/static_cast<T>(CV_PI);
+                    // Estimate 2*pi multiple to remove the spike (rounding n to nearest int)
+                    const int k = cvRound(n);
+                    if (k == 0)
+                        return;
+                    
+                    // Keep the uncorrected row before its first correction
+                    if (ring[i % 3] == pPhi) {
+                        T* copy = buf.ptr<T>(b*BAND_ROWS + RING + i % 3);
+                        std::copy(pPhi, pPhi + w, copy);
+                        ring[i % 3] = copy;
+                        for (const T*& row : rows)
+                            row = row == pPhi ? copy : row;
+                    }
+                    
+                    // Correct phase value
+                    pPhi[j] -= 2*static_cast<T>(CV_PI)*k;
+                    if constexpr (STATS_ENABLED)
+                        corrections++;
+                });
+            });
+        }
+        if constexpr (STATS_ENABLED) {
+            recordSpikeCandidates(candidates);
+            recordSpikeCorrections(corrections);
+        }
+    });
+}
+
+void removeSpikyNoise(cv::Mat& Phi, Workspace* ws, const TileMask& tiles) {
+    StageTimer timer(STATS_MEDIAN, Phi.total()*Phi.elemSize());
+    
+    if (Phi.depth() == CV_32F)
+        removeSpikyNoise_<float>(Phi, ws, tiles);
+    else
+        removeSpikyNoise_<double>(Phi, ws, tiles);
+}
+
+void spikeMedian(const cv::Mat& src, cv::Mat& dst, const cv::Range& rows, float* cmin, float* cmax) {
+    std::uint64_t candidates = 0;
+    for (int y = rows.start; y < rows.end; y++) {
+        const float* nbh[5];
+        for (int d = 0; d < 5; d++)
+            nbh[d] = src.ptr<float>(std::clamp(y + d - 2, 0, src.rows - 1));
+        
+        const float* psrc = src.ptr<float>(y);
+        float* pdst = dst.ptr<float>(y);
+        std::copy(psrc, psrc + src.cols, pdst);
+        forEachCandidate<float>(nbh, src.cols, 0, src.cols, cmin, cmax, [&](int x) {
+            pdst[x] = median5x5<float>(nbh, src.cols, x);
+            if constexpr (STATS_ENABLED)
+                candidates++;
+        });
+    }
+    if constexpr (STATS_ENABLED)
+        recordSpikeCandidates(candidates);
+}
+
+} // namespace sl::detail
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "tile_mask.hpp"
+
+#include <opencv2/core/mat.hpp>
+
+
+namespace sl::detail {
+
+// Remove the 2*pi spikes of an unwrapped phase map (CV_32F or CV_64F) in place, by comparing
+// each pixel with the 5x5 median of its neighborhood. The median is only computed at the spike
+// candidates of the runs of occupied tiles, and the result is the same as with cv::medianBlur. The row
+// buffers are taken from the workspace
+void removeSpikyNoise(cv::Mat& Phi, Workspace* ws, const TileMask& tiles);
+
+// Selective 5x5 median of the rows [rows.start, rows.end) of a CV_32F tile: dst is the median of src
+// (with replicated borders, as cv::medianBlur) at the spike candidates, and src elsewhere. Removing the
+// spikes with dst gives the same result as with the full median. cmin and cmax have room for src.cols values
+void spikeMedian(const cv::Mat& src, cv::Mat& dst, const cv::Range& rows, float* cmin, float* cmax);
+
+} // namespace sl::detail
@@ -0,0 +1,71 @@
+#include "stats.hpp"
+
+#include <atomic>
+
+
+namespace sl {
+
+// Counters of each stage, updated concurrently by the library functions
+static std::atomic<std::int64_t> stage_ns[STATS_NUM_STAGES];
+static std::atomic<std::uint64_t> stage_calls[STATS_NUM_STAGES];
+static std::atomic<std::uint64_t> stage_bytes[STATS_NUM_STAGES];
+
+static std::atomic<std::uint64_t> allocations{0}, allocated_bytes{0};
+static std::atomic<std::uint64_t> spike_corrections{0}, spike_candidates{0};
+
+void detail::recordStage(StatsStage stage, std::int64_t ns, std::uint64_t bytes) {
+    stage_ns[stage] += ns;
+    stage_calls[stage]++;
+    stage_bytes[stage] += bytes;
+}
+
+void detail::recordAllocation(std::uint64_t bytes) {
+    allocations++;
+    allocated_bytes += bytes;
+}
+
+void detail::recordSpikeCorrections(std::uint64_t count) {
+    spike_corrections += count;
+}
+
+void detail::recordSpikeCandidates(std::uint64_t count) {
+    spike_candidates += count;
+}
+
+bool statsEnabled() {
+    return detail::STATS_ENABLED;
+}
+
+Stats getStats() {
+    Stats stats;
+    for (int s = 0; s < STATS_NUM_STAGES; s++) {
+        stats.stages[s].time_ms = stage_ns[s]*1e-6;
+        stats.stages[s].calls = stage_calls[s];
+        stats.stages[s].bytes = stage_bytes[s];
+    }
+    stats.allocations = allocations;
+    stats.allocated_bytes = allocated_bytes;
+    stats.spike_corrections = spike_corrections;
+    stats.spike_candidates = spike_candidates;
+    
+    return stats;
+}
+
+void resetStats() {
+    for (int s = 0; s < STATS_NUM_STAGES; s++) {
+        stage_ns[s] = 0;
+        stage_calls[s] = 0;
+        stage_bytes[s] = 0;
+    }
+    allocations = 0;
+    allocated_bytes = 0;
+    spike_corrections = 0;
+    spike_candidates = 0;
+}
+
+const char* statsStageName(StatsStage stage) {
+    static const char* names[STATS_NUM_STAGES] = {"imread", "phase", "graycode", "median", "unwrap"};
+    return stage >= 0 and stage < STATS_NUM_STAGES ? names[stage] : "unknown";
+}
+
+} // namespace sl
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <SLutils/stats.hpp>
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace sl::detail {
+
+#ifdef SLU_ENABLE_STATS
+constexpr bool STATS_ENABLED = true;
+#else
+constexpr bool STATS_ENABLED = false;
+#endif
+
+void recordStage(StatsStage stage, std::int64_t ns, std::uint64_t bytes);
+void recordAllocation(std::uint64_t bytes);
+void recordSpikeCorrections(std::uint64_t count);
+void recordSpikeCandidates(std::uint64_t count);
+
+/* ---------------------------------------------------------------------------
+Record the wall time of a stage from the construction to the destruction of
+the timer, and the bytes touched by the stage. Without SLU_ENABLE_STATS the
+timer is empty and is removed by the compiler, like the other `if constexpr
+(STATS_ENABLED)` blocks of the instrumentation.
+--------------------------------------------------------------------------- */
+class StageTimer {
+public:
+    StageTimer(StatsStage stage, std::uint64_t bytes) : stage(stage), bytes(bytes) {
+        if constexpr (STATS_ENABLED)
+            start = std::chrono::steady_clock::now();
+    }
+    
+    ~StageTimer() {
+        if constexpr (STATS_ENABLED) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            recordStage(stage, ns.count(), bytes);
+        }
+    }
+    
+    // Bytes touched by the stage, when they are only known after it starts
+    void setBytes(std::uint64_t stage_bytes) { bytes = stage_bytes; }
+    
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StatsStage stage;
+    std::uint64_t bytes;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace sl::detail
@@ -0,0 +1,294 @@
+#include <SLutils/streaming.hpp>
+
+#include "buffers.hpp" // WorkspaceSlot
+#include "fast_math.hpp" // detail::atan2
+#include "frames.hpp" // checkFloatDepth
+#include "graycode.hpp" // gray2bin
+#include "parallel.hpp" // parallelForRows
+#include "tile_mask.hpp"
+#include "unwrap.hpp"
+#include "unwrap_chain.hpp" // checkPeriods
+
+#include <algorithm> // std::fill, std::min
+#include <cmath> // std::sin, std::cos, std::sqrt
+#include <stdexcept> // std::runtime_error
+#include <string>
+
+
+namespace sl {
+
+// Number of pixels of a row processed at once by the finalize step
+constexpr int BLOCK_SIZE = 512;
+
+// Check that a pushed frame is a 2D 8-bit single-channel image of the same size as the previous ones
+static cv::Mat getFrame(cv::InputArray _frame, const cv::Mat& ref, const char* func) {
+    cv::Mat frame = _frame.getMat();
+    if (frame.dims != 2 or frame.type() != CV_8UC1)
+        throw std::runtime_error(std::string(func) + ": frame must be an 8-bit single-channel image");
+    if (!ref.empty() and frame.size() != ref.size())
+        throw std::runtime_error(std::string(func) + ": all frames must have the same size");
+    
+    return frame;
+}
+
+
+/* ----------------------------- PhaseShiftAccumulator ----------------------------- */
+// Number of phase shifts, checked in the initializer list before the vector of pushed images is sized
+static int checkPhaseShifts(int N) {
+    if (N < 3)
+        throw std::runtime_error("PhaseShiftAccumulator needs at least 3 phase shifts");
+    return N;
+}
+
+PhaseShiftAccumulator::PhaseShiftAccumulator(int N, int dtype)
+    : N(checkPhaseShifts(N)), dtype(dtype), pushed(N, false) {
+    detail::checkFloatDepth(dtype, "PhaseShiftAccumulator");
+}
+
+template <typename T>
+static void accumulateFringe(const cv::Mat& I, double delta, cv::Mat& sumIsin, cv::Mat& sumIcos, cv::Mat& sumI) {
+    const T s = static_cast<T>(std::sin(delta)), c = static_cast<T>(std::cos(delta));
+    
+    detail::parallelForRows(I.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            const uchar* pI = I.ptr<uchar>(i);
+            T *psin = sumIsin.ptr<T>(i), *pcos = sumIcos.ptr<T>(i), *psum = sumI.ptr<T>(i);
+            for (int j = 0; j < I.cols; j++) {
+                psin[j] += pI[j]*s;
+                pcos[j] += pI[j]*c;
+                psum[j] += pI[j];
+            }
+        }
+    });
+}
+
+void PhaseShiftAccumulator::push(cv::InputArray _frame, int index) {
+    if (index < 0 or index >= N)
+        throw std::runtime_error("PhaseShiftAccumulator::push: index must be in [0, N)");
+    if (pushed[index])
+        throw std::runtime_error("PhaseShiftAccumulator::push: fringe image " + std::to_string(index) +
+                                 " was already pushed");
+    
+    cv::Mat I = getFrame(_frame, sumI, "PhaseShiftAccumulator::push");
+    
+    // Initialize the sums with the first fringe image
+    if (sumI.empty()) {
+        sumIsin = cv::Mat::zeros(I.size(), dtype);
+        sumIcos = cv::Mat::zeros(I.size(), dtype);
+        sumI = cv::Mat::zeros(I.size(), dtype);
+    }
+    
+    // Phase shift of the fringe image: delta_i = 2*pi*(i + 1)/N
+    double delta = 2*CV_PI*(index + 1)/N;
+    if (dtype == CV_32F)
+        accumulateFringe<float>(I, delta, sumIsin, sumIcos, sumI);
+    else
+        accumulateFringe<double>(I, delta, sumIsin, sumIcos, sumI);
+    
+    pushed[index] = true;
+    n_frames++;
+}
+
+template <typename T>
+static void finalizePhase(const cv::Mat& sumIsin, const cv::Mat& sumIcos, const cv::Mat& sumI,
+                          cv::Mat& phase, cv::Mat& data_modulation) {
+    detail::parallelForRows(phase.rows, [&](int r0, int r1) {
+        T y[BLOCK_SIZE];
+        for (int i = r0; i < r1; i++) {
+            const T *psin = sumIsin.ptr<T>(i), *pcos = sumIcos.ptr<T>(i), *psum = sumI.ptr<T>(i);
+            for (int j0 = 0; j0 < phase.cols; j0 += BLOCK_SIZE) {
+                const int len = std::min(BLOCK_SIZE, phase.cols - j0);
+                
+                // Estimate data modulation: sqrt(sumIcos^2 + sumIsin^2)/sumI
+                if (!data_modulation.empty()) {
+                    T* gamma = data_modulation.ptr<T>(i) + j0;
+                    for (int j = 0; j < len; j++)
+                        gamma[j] = std::sqrt(pcos[j0 + j]*pcos[j0 + j] + psin[j0 + j]*psin[j0 + j])/psum[j0 + j];
+                }
+                
+                // Estimate final wrapped phase as -atan2(sumIsin, sumIcos) = atan2(-sumIsin, sumIcos)
+                for (int j = 0; j < len; j++)
+                    y[j] = -psin[j0 + j];
+                detail::atan2(y, pcos + j0, phase.ptr<T>(i) + j0, len);
+            }
+        }
+    });
+}
+
+void PhaseShiftAccumulator::finalize(cv::OutputArray _phase, cv::OutputArray _data_modulation) const {
+    if (n_frames < 3)
+        throw std::runtime_error("PhaseShiftAccumulator::finalize needs at least 3 fringe patterns");
+    
+    // Set output arrays
+    _phase.create(sumI.size(), dtype);
+    cv::Mat phase = _phase.getMat();
+    
+    cv::Mat data_modulation;
+    if (_data_modulation.needed()) {
+        _data_modulation.create(sumI.size(), dtype);
+        data_modulation = _data_modulation.getMat();
+    }
+    
+    if (dtype == CV_32F)
+        finalizePhase<float>(sumIsin, sumIcos, sumI, phase, data_modulation);
+    else
+        finalizePhase<double>(sumIsin, sumIcos, sumI, phase, data_modulation);
+}
+
+void PhaseShiftAccumulator::reset() {
+    n_frames = 0;
+    std::fill(pushed.begin(), pushed.end(), false);
+    sumIsin.release();
+    sumIcos.release();
+    sumI.release();
+}
+
+
+/* ----------------------------- GrayCodeAccumulator ----------------------------- */
+// Number of graycode bits, checked in the initializer list before the vectors of images are sized
+static int checkGrayBits(int n) {
+    if (n < 1 or n > 31)
+        throw std::runtime_error("GrayCodeAccumulator supports from 1 to 31 graycode bits");
+    return n;
+}
+
+GrayCodeAccumulator::GrayCodeAccumulator(int n) : n(checkGrayBits(n)), pushed(2*n, false), pending(n) {}
+
+void GrayCodeAccumulator::push(cv::InputArray _frame, int index) {
+    if (index < 0 or index >= 2*n)
+        throw std::runtime_error("GrayCodeAccumulator::push: index must be in [0, 2n)");
+    if (pushed[index])
+        throw std::runtime_error("GrayCodeAccumulator::push: graycode image " + std::to_string(index) +
+                                 " was already pushed");
+    
+    cv::Mat frame = getFrame(_frame, gray, "GrayCodeAccumulator::push");
+    if (gray.empty())
+        gray = cv::Mat::zeros(frame.size(), CV_32S);
+    
+    pushed[index] = true;
+    n_frames++;
+    
+    // Keep a copy of the first image of a pair until its counterpart arrives
+    const int k = index/2;
+    if (!pushed[index ^ 1]) {
+        pending[k] = frame.clone();
+        return;
+    }
+    
+    // Pattern and inverted pattern of the k-th pair
+    const cv::Mat& im1 = index % 2 == 0 ? frame : pending[k];
+    const cv::Mat& im2 = index % 2 == 0 ? pending[k] : frame;
+    
+    // Set the gray bit of the pair in the bit position n - k - 1 (the first pair is the MSB)
+    const int bit = 1 << (n - k - 1);
+    detail::parallelForRows(gray.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            const uchar *pim1 = im1.ptr<uchar>(i), *pim2 = im2.ptr<uchar>(i);
+            int* pgray = gray.ptr<int>(i);
+            for (int j = 0; j < gray.cols; j++)
+                pgray[j] |= pim1[j] > pim2[j] ? bit : 0;
+        }
+    });
+    
+    pending[k].release();
+}
+
+void GrayCodeAccumulator::finalize(cv::OutputArray _dec) const {
+    if (n_frames != 2*n)
+        throw std::runtime_error("GrayCodeAccumulator::finalize needs all the 2n graycode images");
+    
+    _dec.create(gray.size(), CV_32S);
+    cv::Mat dec = _dec.getMat();
+    
+    // Convert the gray words to decimal
+    detail::parallelForRows(gray.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            const int* pgray = gray.ptr<int>(i);
+            int* pdec = dec.ptr<int>(i);
+            for (int j = 0; j < gray.cols; j++)
+                pdec[j] = detail::gray2bin(pgray[j]);
+        }
+    });
+}
+
+void GrayCodeAccumulator::codeWord(cv::OutputArray _code_word) const {
+    if (n_frames != 2*n)
+        throw std::runtime_error("GrayCodeAccumulator::codeWord needs all the 2n graycode images");
+    if (n > 16)
+        throw std::runtime_error("GrayCodeAccumulator::codeWord supports up to 16 graycode bits");
+    
+    gray.convertTo(_code_word, CV_16U);
+}
+
+void GrayCodeAccumulator::reset() {
+    n_frames = 0;
+    std::fill(pushed.begin(), pushed.end(), false);
+    for (cv::Mat& frame : pending)
+        frame.release();
+    gray.release();
+}
+
+
+/* ----------------------------- Unwrapping ----------------------------- */
+void phaseGraycodingUnwrap(const PhaseShiftAccumulator& ps, const GrayCodeAccumulator& gc,
+                           cv::OutputArray _Phi, int p, Workspace* ws, cv::InputArray mask) {
+    // Estimate wrapped phase map
+    cv::Mat local_phi;
+    cv::Mat& phi = ws ? ws->buffer(detail::WS_PHASE1) : local_phi;
+    ps.finalize(phi);
+    
+    // Estimate decimal map (phase order)
+    cv::Mat local_k;
+    cv::Mat& k = ws ? ws->buffer(detail::WS_ORDER) : local_k;
+    gc.finalize(k);
+    if (k.size() != phi.size())
+        throw std::runtime_error("phaseGraycodingUnwrap: fringe and graycode images must have the same size");
+    
+    const detail::TileMask tiles(mask, phi.size(), ws, "phaseGraycodingUnwrap");
+    detail::graycodeUnwrap(phi, k, _Phi, p, ws, tiles);
+    tiles.clearOutside(_Phi);
+}
+
+void threeFreqPhaseUnwrap(const PhaseShiftAccumulator& ps1, const PhaseShiftAccumulator& ps2,
+                          const PhaseShiftAccumulator& ps3, cv::OutputArray _Phi, const cv::Vec3i& p,
+                          Workspace* ws, cv::InputArray mask) {
+    detail::checkPeriods(p.val, 3, "threeFreqPhaseUnwrap");
+    
+    // Estimating wrapped phase map for each frequency
+    cv::Mat local_phi1, local_phi2, local_phi3;
+    cv::Mat& phi1 = ws ? ws->buffer(detail::WS_PHASE1) : local_phi1;
+    cv::Mat& phi2 = ws ? ws->buffer(detail::WS_PHASE2) : local_phi2;
+    cv::Mat& phi3 = ws ? ws->buffer(detail::WS_PHASE3) : local_phi3;
+    ps1.finalize(phi1);
+    ps2.finalize(phi2);
+    ps3.finalize(phi3);
+    if (phi1.size() != phi2.size() or phi1.size() != phi3.size() or
+        phi1.type() != phi2.type() or phi1.type() != phi3.type())
+        throw std::runtime_error("threeFreqPhaseUnwrap: accumulators must have the same image size and dtype");
+    
+    const detail::TileMask tiles(mask, phi1.size(), ws, "threeFreqPhaseUnwrap");
+    const cv::Mat phases[3] = {phi1, phi2, phi3};
+    detail::multiFreqUnwrap(phases, p.val, 3, MULTIFREQ_HETERODYNE, _Phi, ws, tiles, "threeFreqPhaseUnwrap");
+    tiles.clearOutside(_Phi);
+}
+
+void twoFreqPhaseUnwrap(const PhaseShiftAccumulator& ps1, const PhaseShiftAccumulator& ps2,
+                        cv::OutputArray _Phi, const cv::Vec3i& p, Workspace* ws, cv::InputArray mask) {
+    detail::checkPeriods(p.val, 2, "twoFreqPhaseUnwrap");
+    
+    // Estimating wrapped phase map for each frequency
+    cv::Mat local_phi1, local_phi2;
+    cv::Mat& phi1 = ws ? ws->buffer(detail::WS_PHASE1) : local_phi1;
+    cv::Mat& phi2 = ws ? ws->buffer(detail::WS_PHASE2) : local_phi2;
+    ps1.finalize(phi1);
+    ps2.finalize(phi2);
+    if (phi1.size() != phi2.size() or phi1.type() != phi2.type())
+        throw std::runtime_error("twoFreqPhaseUnwrap: accumulators must have the same image size and dtype");
+    
+    const detail::TileMask tiles(mask, phi1.size(), ws, "twoFreqPhaseUnwrap");
+    const cv::Mat phases[2] = {phi1, phi2};
+    detail::multiFreqUnwrap(phases, p.val, 2, MULTIFREQ_HETERODYNE, _Phi, ws, tiles, "twoFreqPhaseUnwrap");
+    tiles.clearOutside(_Phi);
+}
+
+} // namespace sl
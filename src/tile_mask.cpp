@@ -0,0 +1,130 @@
+#include "tile_mask.hpp"
+
+#include "parallel.hpp" // parallelForRows
+
+#include <opencv2/core.hpp> // cv::countNonZero
+
+#include <algorithm> // std::min, std::max
+#include <cstring> // std::memset
+#include <stdexcept> // std::runtime_error
+#include <string>
+
+
+namespace sl::detail {
+
+TileMask::TileMask(cv::InputArray _mask, cv::Size size, Workspace* ws, const char* func) : size(size) {
+    if (_mask.empty())
+        return;
+    
+    mask = _mask.getMat();
+    if (mask.type() != CV_8UC1 or mask.size() != size)
+        throw std::runtime_error(std::string(func) + ": mask must be a CV_8U array of the same size as the images");
+    
+    // Occupancy of each tile, including the mask pixels within HALO pixels of it
+    const int th = (size.height + TILE - 1)/TILE, tw = rowTiles(size.width);
+    cv::Mat occupied = getBuffer(ws, WS_TILE_OCCUPIED, {tw, th}, CV_8U);
+    const cv::Rect image({0, 0}, size);
+    parallelForRows(th, [&](int t0, int t1) {
+        for (int ti = t0; ti < t1; ti++) {
+            for (int tj = 0; tj < tw; tj++) {
+                const cv::Rect tile(tj*TILE - HALO, ti*TILE - HALO, TILE + 2*HALO, TILE + 2*HALO);
+                occupied.at<uchar>(ti, tj) = cv::countNonZero(mask(tile & image)) > 0;
+            }
+        }
+    });
+    
+    setRuns(occupied, ws, WS_MASK_RUNS, WS_MASK_OFFSETS);
+}
+
+TileMask::TileMask(const cv::Mat& mask, const cv::Mat& extents, Workspace* ws) : size(mask.size()), mask(mask) {
+    // A tile is occupied if some row of it or of its halo has non-zero pixels in it, or within HALO
+    // columns of it in the neighbor tiles
+    const int th = (size.height + TILE - 1)/TILE, tw = rowTiles(size.width);
+    cv::Mat occupied = getBuffer(ws, WS_TILE_OCCUPIED, {tw, th}, CV_8U);
+    occupied.setTo(0);
+    parallelForRows(th, [&](int t0, int t1) {
+        for (int ti = t0; ti < t1; ti++) {
+            uchar* pocc = occupied.ptr<uchar>(ti);
+            const int y0 = std::max(ti*TILE - HALO, 0), y1 = std::min((ti + 1)*TILE + HALO, size.height);
+            for (int y = y0; y < y1; y++) {
+                const cv::Vec2i* e = extents.ptr<cv::Vec2i>(y);
+                for (int tj = 0; tj < tw; tj++) {
+                    pocc[tj] |= e[tj][0] < e[tj][1] or
+                                (tj > 0 and e[tj-1][0] < e[tj-1][1] and e[tj-1][1] > tj*TILE - HALO) or
+                                (tj + 1 < tw and e[tj+1][0] < e[tj+1][1] and e[tj+1][0] < (tj + 1)*TILE + HALO);
+                }
+            }
+        }
+    });
+    
+    setRuns(occupied, ws, WS_VALID_RUNS, WS_VALID_OFFSETS);
+}
+
+void TileMask::setRuns(const cv::Mat& occupied, Workspace* ws, int runs_slot, int offsets_slot) {
+    // Runs of consecutive occupied tiles of each tile row. Two runs are separated by at least one tile
+    const int th = occupied.rows, tw = occupied.cols;
+    runs = getBuffer(ws, runs_slot, {th*((tw + 1)/2), 1}, CV_32SC4);
+    offsets = getBuffer(ws, offsets_slot, {th + 1, 1}, CV_32S);
+    cv::Rect* pruns = runs.ptr<cv::Rect>();
+    int* poffsets = offsets.ptr<int>();
+    
+    nruns = 0;
+    poffsets[0] = 0;
+    for (int ti = 0; ti < th; ti++) {
+        const uchar* pocc = occupied.ptr<uchar>(ti);
+        for (int tj = 0; tj < tw; tj++) {
+            if (!pocc[tj])
+                continue;
+            
+            const int tj0 = tj;
+            while (tj + 1 < tw and pocc[tj + 1])
+                tj++;
+            
+            const int j0 = tj0*TILE, j1 = std::min((tj + 1)*TILE, size.width);
+            const int i0 = ti*TILE, i1 = std::min((ti + 1)*TILE, size.height);
+            pruns[nruns++] = cv::Rect(j0, i0, j1 - j0, i1 - i0);
+        }
+        poffsets[ti + 1] = nruns;
+    }
+}
+
+void maskRowExtents(const uchar* row, int width, cv::Vec2i* extents) {
+    for (int tj = 0, j0 = 0; j0 < width; tj++, j0 += TileMask::TILE) {
+        const int j1 = std::min(j0 + TileMask::TILE, width);
+        int first = j0;
+        while (first < j1 and !row[first])
+            first++;
+        int last = j1;
+        while (last > first and !row[last - 1])
+            last--;
+        
+        extents[tj] = first < last ? cv::Vec2i(first, last) : cv::Vec2i(0, 0);
+    }
+}
+
+void TileMask::clearOutside(cv::OutputArray dst) const {
+    if (mask.empty() or !dst.needed())
+        return;
+    
+    cv::Mat m = dst.getMat();
+    const size_t esize = m.elemSize();
+    parallelForRows(m.rows, [&](int r0, int r1) {
+        for (int i = r0; i < r1; i++) {
+            uchar* row = m.ptr<uchar>(i);
+            const uchar* pmask = mask.ptr<uchar>(i);
+            
+            // Spans of masked pixels, both in the skipped tiles and inside the runs
+            int j = 0;
+            while (j < m.cols) {
+                while (j < m.cols and pmask[j])
+                    j++;
+                const int j0 = j;
+                while (j < m.cols and !pmask[j])
+                    j++;
+                std::memset(row + j0*esize, 0, (j - j0)*esize);
+            }
+        }
+    });
+}
+
+} // namespace sl::detail
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "buffers.hpp" // getBuffer, WorkspaceSlot
+
+#include <opencv2/core/mat.hpp>
+
+#include <algorithm> // std::max, std::min
+
+
+namespace sl::detail {
+
+/* ---------------------------------------------------------------------------
+Coarse occupancy of the optional mask of the decoders, in tiles of TILE x
+TILE pixels. A tile is occupied when some mask pixel is within HALO pixels of
+it, so that the 5x5 median filters of the unwrapping see at the valid pixels
+the same neighbors as without a mask. The consecutive occupied tiles of each
+tile row are merged in runs, and the decoders only load and compute the
+pixels of the runs: fully masked tiles cost nothing. Without a mask the whole
+image is a single run, so the results are the same as before. The outputs of
+the public functions are set to 0 at the pixels outside the mask.
+--------------------------------------------------------------------------- */
+class TileMask {
+public:
+    static constexpr int TILE = 64;
+    static constexpr int HALO = 2;
+    
+    // mask must be empty (no mask) or a CV_8U array of the given size. Non-zero pixels are valid. The runs
+    // are stored in the WS_MASK_RUNS and WS_MASK_OFFSETS buffers of the workspace
+    TileMask(cv::InputArray mask, cv::Size size, Workspace* ws, const char* func);
+    
+    // Tiles of a mask whose column extents (see maskRowExtents) were recorded when it was written,
+    // without reading the mask again. The runs are stored in the WS_VALID_RUNS and WS_VALID_OFFSETS buffers
+    TileMask(const cv::Mat& mask, const cv::Mat& extents, Workspace* ws);
+    
+    bool hasMask() const { return !mask.empty(); }
+    
+    // Row i of the mask, or null when there is no mask
+    const uchar* maskRow(int i) const { return mask.empty() ? nullptr : mask.ptr<uchar>(i); }
+    
+    cv::Size imageSize() const { return size; }
+    
+    // Call body(j0, j1) for each run of columns [j0, j1) of the row i
+    template <typename Body>
+    void forEachRun(int i, const Body& body) const {
+        if (mask.empty()) {
+            body(0, size.width);
+            return;
+        }
+        
+        const int t = i/TILE;
+        const int* poffsets = offsets.ptr<int>();
+        const cv::Rect* pruns = runs.ptr<cv::Rect>();
+        for (int r = poffsets[t]; r < poffsets[t+1]; r++)
+            body(pruns[r].x, pruns[r].x + pruns[r].width);
+    }
+    
+    // Call body(x0, x1) for the column ranges of the runs of the rows [y0, y1), expanded by halo columns
+    // and merged when they overlap, from left to right. Each run of these rows lies in one of the ranges.
+    // The rows must be in at most two tile rows, e.g. y1 - y0 <= TILE
+    template <typename Body>
+    void forEachSpan(int y0, int y1, int halo, const Body& body) const {
+        if (y0 >= y1)
+            return;
+        if (mask.empty()) {
+            body(0, size.width);
+            return;
+        }
+        
+        // Merge the runs of both tile rows, which are sorted by column
+        const int t0 = y0/TILE, t1 = (y1 - 1)/TILE;
+        const int* poffsets = offsets.ptr<int>();
+        const cv::Rect* pruns = runs.ptr<cv::Rect>();
+        int a = poffsets[t0], a_end = poffsets[t0+1];
+        int b = t1 > t0 ? poffsets[t1] : a_end, b_end = t1 > t0 ? poffsets[t1+1] : a_end;
+        int x0 = 0, x1 = -1;
+        while (a < a_end or b < b_end) {
+            const cv::Rect& run = b == b_end or (a < a_end and pruns[a].x <= pruns[b].x) ? pruns[a++] : pruns[b++];
+            const int start = std::max(run.x - halo, 0), end = std::min(run.x + run.width + halo, size.width);
+            if (x1 >= 0 and start <= x1) {
+                x1 = std::max(x1, end);
+                continue;
+            }
+            
+            if (x1 >= 0)
+                body(x0, x1);
+            x0 = start;
+            x1 = end;
+        }
+        if (x1 >= 0)
+            body(x0, x1);
+    }
+    
+    // Number of runs. Without a mask, the whole image is a single run
+    int numRuns() const { return mask.empty() ? 1 : nruns; }
+    
+    // Rectangle of the run r
+    cv::Rect runRect(int r) const { return mask.empty() ? cv::Rect({0, 0}, size) : runs.ptr<cv::Rect>()[r]; }
+    
+    // Set the pixels of an output array outside the mask to 0. Nothing is done if the output is not needed
+    void clearOutside(cv::OutputArray dst) const;
+
+private:
+    void setRuns(const cv::Mat& occupied, Workspace* ws, int runs_slot, int offsets_slot);
+    
+    cv::Size size;
+    cv::Mat mask;
+    cv::Mat runs; // rectangles of the runs of tile row t: runs[offsets[t]], ..., runs[offsets[t+1] - 1]
+    cv::Mat offsets;
+    int nruns = 0;
+};
+
+// Number of tiles of a mask row of the given width
+inline int rowTiles(int width) { return (width + TileMask::TILE - 1)/TileMask::TILE; }
+
+// Columns [first, last + 1) of the non-zero pixels of each tile of a mask row, or (0, 0) for the
+// tiles without them. extents has rowTiles(width) elements
+void maskRowExtents(const uchar* row, int width, cv::Vec2i* extents);
+
+} // namespace sl::detail
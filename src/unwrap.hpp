@@ -0,0 +1,26 @@
+#pragma once
+
+#include <SLutils/multifrequency.hpp> // MultiFreqMethod
+#include <SLutils/workspace.hpp>
+
+#include "tile_mask.hpp"
+
+#include <opencv2/core/mat.hpp>
+
+
+namespace sl::detail {
+
+// Unwrap the K wrapped phase maps (CV_32F or CV_64F) of the given periods with the multi-frequency
+// method. The unwrapped phase of periods[0] is written to Phi, which can't share data with the
+// inputs. The workspace (which can be null) provides the tile buffers, and func is the name used
+// in the error messages. Only the runs of occupied tiles are unwrapped
+void multiFreqUnwrap(const cv::Mat* phases, const int* periods, int K, MultiFreqMethod method,
+                     cv::OutputArray Phi, Workspace* ws, const TileMask& tiles, const char* func);
+
+// Unwrap the phase map phi (overwritten) of fringes of period p using the phase order map k
+// (CV_32S) decoded from the graycode patterns. Phi has the same type as phi. Only the runs of
+// occupied tiles are unwrapped
+void graycodeUnwrap(cv::Mat& phi, const cv::Mat& k, cv::OutputArray Phi, int p, Workspace* ws,
+                    const TileMask& tiles);
+
+} // namespace sl::detail
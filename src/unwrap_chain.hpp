@@ -0,0 +1,123 @@
+#pragma once
+
+#include <SLutils/multifrequency.hpp> // MultiFreqMethod
+
+#include <algorithm> // std::stable_sort
+#include <cmath> // std::abs, std::isfinite
+#include <cstddef> // std::size_t
+#include <stdexcept> // std::runtime_error
+#include <string>
+
+
+namespace sl::detail {
+
+// Maximum number of frequencies of the multi-frequency unwrapping
+constexpr int MAX_FREQUENCIES = 8;
+
+// Equivalent (beat) period of two fringe periods
+inline double equivalentPeriod(double T1, double T2) {
+    return T1*T2/std::abs(T1-T2);
+}
+
+// Check the periods of K frequencies
+inline void checkPeriods(const int* periods, int K, const char* func) {
+    for (int i = 0; i < K; i++) {
+        if (periods[i] < 1)
+            throw std::runtime_error(std::string(func) + ": fringe periods must be positive");
+    }
+}
+
+// Check the periods and number of phase shifts of K frequencies, and the number of input frames
+inline void checkFrequencies(const int* periods, const int* steps, int K, std::size_t nframes, const char* func) {
+    if (K < 2 or K > MAX_FREQUENCIES)
+        throw std::runtime_error(std::string(func) + ": the number of frequencies must be between 2 and 8");
+    
+    std::size_t npatterns = 0;
+    for (int i = 0; i < K; i++) {
+        if (steps[i] < 3)
+            throw std::runtime_error(std::string(func) + " needs at least 3 fringe patterns per frequency");
+        npatterns += steps[i];
+    }
+    checkPeriods(periods, K, func);
+    
+    if (nframes != npatterns)
+        throw std::runtime_error(std::string(func) + ": number of image paths and number of patterns N must match");
+}
+
+/* ---------------------------------------------------------------------------
+Backward unwrapping chain of the heterodyne and hierarchical methods for K
+frequencies. The chain starts from a wide phase without discontinuities of
+period wide_period, and each step unwraps a phase of period period[s] with
+the phase unwrapped in the previous step. A step index i < K refers to the
+wrapped phase i, and i >= K to the equivalent phase of the wrapped phases
+i-K and i-K+1.
+
+Heterodyne: the wide phase is the equivalent phase of all the frequencies,
+eq(...eq(eq(phi1, phi2), phi3)..., phiK), and the chain goes through the
+equivalent phases of consecutive frequencies (when K >= 3), from the last
+pair to the first one, and then through the wrapped phases from phiK down
+to phi1. For K = 3 this is Phi123 -> phi23 -> phi12 -> phi3 -> phi2 -> phi1.
+
+Hierarchical: the wrapped phase of the widest period is the wide phase (it
+must cover the whole field with a single fringe), and the chain goes
+through the periods in decreasing order down to the period of phi1.
+--------------------------------------------------------------------------- */
+struct UnwrapChain {
+    int K;
+    int wide; // wrapped phase used as wide phase (hierarchical), or -1 (heterodyne)
+    double wide_period;
+    int nsteps;
+    int index[2*MAX_FREQUENCIES];
+    double period[2*MAX_FREQUENCIES];
+};
+
+inline UnwrapChain buildUnwrapChain(const int* periods, int K, MultiFreqMethod method, const char* func) {
+    UnwrapChain chain{};
+    chain.K = K;
+    
+    if (method == MULTIFREQ_HETERODYNE) {
+        // Equivalent period of all the frequencies
+        chain.wide = -1;
+        chain.wide_period = equivalentPeriod(periods[0], periods[1]);
+        for (int i = 2; i < K; i++)
+            chain.wide_period = equivalentPeriod(chain.wide_period, periods[i]);
+        
+        // Equivalent phases of consecutive frequencies
+        if (K >= 3) {
+            for (int i = K-2; i >= 0; i--) {
+                chain.index[chain.nsteps] = K + i;
+                chain.period[chain.nsteps++] = equivalentPeriod(periods[i], periods[i+1]);
+            }
+        }
+        
+        // Wrapped phases
+        for (int i = K-1; i >= 0; i--) {
+            chain.index[chain.nsteps] = i;
+            chain.period[chain.nsteps++] = periods[i];
+        }
+        
+        for (int s = 0; s < chain.nsteps; s++) {
+            if (!std::isfinite(chain.period[s]) or !std::isfinite(chain.wide_period))
+                throw std::runtime_error(std::string(func) + ": the heterodyne method needs different consecutive periods");
+        }
+    }
+    else if (method == MULTIFREQ_HIERARCHICAL) {
+        // Sort the frequencies from the widest to the narrowest period
+        int order[MAX_FREQUENCIES];
+        for (int i = 0; i < K; i++) order[i] = i;
+        std::stable_sort(order, order + K, [&](int a, int b) { return periods[a] > periods[b]; });
+        
+        chain.wide = order[0];
+        chain.wide_period = periods[order[0]];
+        for (int i = 1; i < K and order[i-1] != 0; i++) {
+            chain.index[chain.nsteps] = order[i];
+            chain.period[chain.nsteps++] = periods[order[i]];
+        }
+    }
+    else
+        throw std::runtime_error(std::string(func) + ": invalid unwrapping method for a backward unwrapping chain");
+    
+    return chain;
+}
+
+} // namespace sl::detail
@@ -0,0 +1,29 @@
+#include <SLutils/workspace.hpp>
+
+#include <stdexcept> // std::runtime_error
+
+
+namespace sl {
+
+cv::Mat& Workspace::buffer(int slot) {
+    if (slot < 0 or slot >= NUM_BUFFERS)
+        throw std::runtime_error("Workspace::buffer: invalid slot");
+    
+    return buffers[slot];
+}
+
+std::size_t Workspace::memoryUsage() const {
+    std::size_t size = 0;
+    for (const cv::Mat& buf : buffers)
+        size += buf.total()*buf.elemSize();
+    
+    return size;
+}
+
+void Workspace::release() {
+    for (cv::Mat& buf : buffers)
+        buf.release();
+    frame_list.clear();
+}
+
+} // namespace sl
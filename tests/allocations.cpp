@@ -0,0 +1,208 @@
+#include <SLutils/fringe_analysis.hpp>
+#include <SLutils/graycoding.hpp>
+#include <SLutils/multifrequency.hpp>
+#include <SLutils/phase_graycoding.hpp>
+#include <SLutils/stats.hpp>
+#include <SLutils/streaming.hpp>
+#include <SLutils/workspace.hpp>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp> // cv::circle
+
+#include "synthetic.hpp" // makeFringes, makeGraycode
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib> // std::malloc, std::free
+#include <new> // std::bad_alloc
+#include <vector>
+
+
+/* ---------------------------------------------------------------------------
+Steady-state allocations of the functions that take a Workspace. Each
+function is called twice with the same workspace and output arrays, and the
+second call must not allocate memory: no operator new, no cv::Mat data and,
+when the library is built with SLU_ENABLE_STATS, no intermediate array
+counted by sl::getStats. OpenCV allocates a job for each cv::parallel_for_
+call on its thread pool, so the test runs on a single thread.
+--------------------------------------------------------------------------- */
+
+static std::atomic<std::size_t> new_calls{0};
+
+void* operator new(std::size_t size) {
+    new_calls++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// cv::Mat allocator that counts the arrays allocated with their own data
+class CountingAllocator : public cv::MatAllocator {
+public:
+    CountingAllocator() : std_allocator(cv::Mat::getStdAllocator()) {}
+    
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        cv::UMatData* u = std_allocator->allocate(dims, sizes, type, data, step, flags, usage);
+        if (u and !data)
+            count++;
+        if (u)
+            u->currAllocator = u->prevAllocator = this;
+        return u;
+    }
+    
+    bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        return std_allocator->allocate(u, flags, usage);
+    }
+    
+    void deallocate(cv::UMatData* u) const override {
+        std_allocator->deallocate(u);
+    }
+    
+    std::size_t allocations() const { return count; }
+    
+private:
+    cv::MatAllocator* std_allocator;
+    mutable std::atomic<std::size_t> count{0};
+};
+
+static CountingAllocator& countingAllocator() {
+    static CountingAllocator allocator;
+    return allocator;
+}
+
+struct Allocations {
+    std::size_t news, mats;
+    std::uint64_t buffers;
+};
+
+static Allocations allocations() {
+    return {new_calls.load(), countingAllocator().allocations(), sl::getStats().allocations};
+}
+
+static int failures = 0;
+
+// Call call(ws, out1, out2) twice and check that the second call does not allocate
+template <typename Call>
+static void check(const char* name, int dtype, bool masked, const Call& call) {
+    sl::Workspace ws;
+    cv::Mat out1, out2;
+    call(ws, out1, out2);
+    
+    const Allocations before = allocations();
+    call(ws, out1, out2);
+    const Allocations after = allocations();
+    
+    const std::size_t news = after.news - before.news, mats = after.mats - before.mats;
+    const std::uint64_t buffers = after.buffers - before.buffers;
+    const bool ok = news == 0 and mats == 0 and buffers == 0;
+    std::printf("%-36s %s %-8s %s (operator new: %zu, cv::Mat: %zu, workspace: %llu)\n", name,
+                dtype == CV_32F ? "CV_32F" : "CV_64F", masked ? "mask" : "no mask", ok ? "ok" : "FAILED",
+                news, mats, static_cast<unsigned long long>(buffers));
+    failures += !ok;
+}
+
+int main() {
+    const int h = 240, w = 320, p = 18, N = 18;
+    cv::setNumThreads(1);
+    cv::Mat::setDefaultAllocator(&countingAllocator());
+    
+    // Inputs of the phase-shifting, graycoding and multi-frequency functions
+    const std::vector<cv::Mat> fringes = makeFringes(h, w, p, N), three_step = makeFringes(h, w, p, 3);
+    const std::vector<cv::Mat> graycode = makeGraycode(h, w, p), complementary = makeGraycode(h, w, p/2);
+    const cv::Vec3i periods(36, 42, 48), steps(4, 4, 4);
+    const std::vector<cv::Mat> multi = makeFringes(h, w, {periods[0], periods[1], periods[2]}, steps[0]);
+    const std::vector<cv::Mat> two_freq(multi.begin(), multi.begin() + 2*steps[0]);
+    const std::vector<cv::Vec2i> freqs = {{periods[0], steps[0]}, {periods[1], steps[1]}, {periods[2], steps[2]}};
+    
+    cv::Mat circle = cv::Mat::zeros(h, w, CV_8U);
+    cv::circle(circle, {w/2, h/2}, h/3, 255, cv::FILLED);
+    
+    for (int dtype : {CV_32F, CV_64F}) {
+        // Accumulators of the streaming functions
+        sl::PhaseShiftAccumulator ps(N, dtype), ps1(steps[0], dtype), ps2(steps[1], dtype), ps3(steps[2], dtype);
+        for (int i = 0; i < N; i++)
+            ps.push(fringes[i], i);
+        for (int i = 0; i < steps[0]; i++) {
+            ps1.push(multi[i], i);
+            ps2.push(multi[steps[0] + i], i);
+            ps3.push(multi[2*steps[0] + i], i);
+        }
+        sl::GrayCodeAccumulator gc(graycode.size()/2);
+        for (int i = 0; i < static_cast<int>(graycode.size()); i++)
+            gc.push(graycode[i], i);
+        
+        for (bool masked : {false, true}) {
+            const cv::Mat mask = masked ? circle : cv::Mat();
+            
+            check("NStepPhaseShifting", dtype, masked, [&](sl::Workspace& ws, cv::Mat& phase, cv::Mat&) {
+                sl::NStepPhaseShifting(fringes, phase, N, dtype, &ws, mask);
+            });
+            check("NStepPhaseShifting_modulation", dtype, masked, [&](sl::Workspace& ws, cv::Mat& phase, cv::Mat& B) {
+                sl::NStepPhaseShifting_modulation(fringes, phase, B, N, dtype, &ws, mask);
+            });
+            check("NStepPhaseShifting_valid", dtype, masked, [&](sl::Workspace& ws, cv::Mat& phase, cv::Mat& valid) {
+                sl::NStepPhaseShifting_valid(fringes, phase, valid, N, sl::ValidityCriteria(), dtype, &ws, mask);
+            });
+            check("ThreeStepPhaseShifting", dtype, masked, [&](sl::Workspace& ws, cv::Mat& phase, cv::Mat&) {
+                sl::ThreeStepPhaseShifting(three_step, phase, dtype, &ws, mask);
+            });
+            check("ThreeStepPhaseShifting_modulation", dtype, masked, [&](sl::Workspace& ws, cv::Mat& phase, cv::Mat& B) {
+                sl::ThreeStepPhaseShifting_modulation(three_step, phase, B, dtype, &ws, mask);
+            });
+            check("decimalMap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& dec, cv::Mat&) {
+                sl::decimalMap(graycode, dec, &ws, mask);
+            });
+            check("graycodeword", dtype, masked, [&](sl::Workspace& ws, cv::Mat& code_word, cv::Mat&) {
+                sl::graycodeword(graycode, code_word, &ws, mask);
+            });
+            check("graycodewordPacked", dtype, masked, [&](sl::Workspace& ws, cv::Mat& code_word, cv::Mat&) {
+                sl::graycodewordPacked(graycode, code_word, &ws, mask);
+            });
+            check("phaseGraycodingUnwrap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::phaseGraycodingUnwrap(fringes, graycode, Phi, p, N, dtype, &ws, mask);
+            });
+            check("phaseGraycodingUnwrap_valid", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat& valid) {
+                sl::phaseGraycodingUnwrap_valid(fringes, graycode, Phi, valid, p, N, sl::ValidityCriteria(), dtype,
+                                                &ws, mask);
+            });
+            check("complementaryGraycodingUnwrap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::complementaryGraycodingUnwrap(fringes, complementary, Phi, N, dtype, &ws, mask);
+            });
+            check("threeFreqPhaseUnwrap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::threeFreqPhaseUnwrap(multi, Phi, periods, steps, dtype, &ws, mask);
+            });
+            check("twoFreqPhaseUnwrap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::twoFreqPhaseUnwrap(two_freq, Phi, periods, steps, dtype, &ws, mask);
+            });
+            for (sl::MultiFreqMethod method : {sl::MULTIFREQ_HETERODYNE, sl::MULTIFREQ_HIERARCHICAL,
+                                               sl::MULTIFREQ_NUMBER_THEORETIC}) {
+                check("multiFreqPhaseUnwrap", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                    sl::multiFreqPhaseUnwrap(multi, Phi, freqs, method, dtype, &ws, mask);
+                });
+            }
+            check("phaseGraycodingUnwrap (accumulators)", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::phaseGraycodingUnwrap(ps, gc, Phi, p, &ws, mask);
+            });
+            check("threeFreqPhaseUnwrap (accumulators)", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::threeFreqPhaseUnwrap(ps1, ps2, ps3, Phi, periods, &ws, mask);
+            });
+            check("twoFreqPhaseUnwrap (accumulators)", dtype, masked, [&](sl::Workspace& ws, cv::Mat& Phi, cv::Mat&) {
+                sl::twoFreqPhaseUnwrap(ps1, ps2, Phi, periods, &ws, mask);
+            });
+        }
+    }
+    
+    if (!sl::statsEnabled())
+        std::printf("The workspace allocations are not counted: build with SLU_ENABLE_STATS to count them\n");
+    
+    return failures == 0 ? 0 : 1;
+}